@@ -26,11 +26,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <sys/socket.h>
 #include <sys/types.h>
-#include <sys/select.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include "synexec_comm.h"
@@ -46,6 +51,19 @@ uint16_t                net_port = 0;           // Network port
 extern uint32_t         session;
 extern int              verbose;
 
+// Receive buffer of a connection
+typedef struct {
+	char            buf[SYNEXEC_COMM_RECV_BUF];
+	size_t          off;                    // Start of the bytes not yet consumed
+	size_t          len;                    // Bytes not yet consumed
+} comm_rbuf_t;
+
+// Receive buffers (indexed by socket) and payload pool, each thread keeps its own
+static __thread comm_rbuf_t     **comm_rbufs = NULL;
+static __thread int             comm_nrbufs = 0;
+static __thread void            *comm_pool[SYNEXEC_COMM_POOL];
+static __thread char            comm_pool_used[SYNEXEC_COMM_POOL];
+
 /*
  * int
  * comm_init(uint16_t _net_port, char *_net_ifname, char force_bcast);
@@ -120,65 +138,128 @@ err:
 
 /*
  * static int
- * _comm_send(int sock, struct timeval *timeout, void *data, uint16_t datalen);
- * ----------------------------------------------------------------------------
- *  This function sends 'datalen' bytes from the buffer contained in 'data' to
- *  the TCP socket 'sock'. If 'timeout' is specified, it will be used.
- *  Otherwise the system default is used.
+ * comm_poll(int sock, short events, struct timeval *timeout);
+ * -----------------------------------------------------------
+ *  This function waits for 'events' on 'sock' using poll(), so it is not
+ *  limited to descriptors below FD_SETSIZE. If 'timeout' is specified, it
+ *  will be used. Otherwise the system default is used.
  *
- *  Mandatory params: sock, data, datalen
+ *  Mandatory params: sock, events
  *  Optional params : timeout
  *
  *  Return values:
  *   -1 Error
  *    0 Timeout
- *    n Bytes sent
+ *    1 Socket ready
  */
 static int
-_comm_send(int sock, struct timeval *timeout, void *data, uint16_t datalen){
+comm_poll(int sock, short events, struct timeval *timeout){
 	// Local variables
-	fd_set                  fds;            // Select fd_set
-	struct timeval          fds_timeout;    // Select timeout
+	struct pollfd           pfd;            // Poll descriptor
+	int                     msecs;          // Poll timeout
 
-	int                     err = 0;        // Return code
-
-	// Wait for socket to become ready for writing
-	FD_ZERO(&fds);
-	FD_SET(sock, &fds);
+	// Convert timeout
 	if (timeout){
-		err = select(sock+1, NULL, &fds, NULL, timeout);
+		msecs = (timeout->tv_sec * 1000) + (timeout->tv_usec / 1000);
 	}else{
-		fds_timeout.tv_sec  = SYNEXEC_COMM_TIMEOUT_SEC;
-		fds_timeout.tv_usec = SYNEXEC_COMM_TIMEOUT_USEC;
-		err = select(sock+1, NULL, &fds, NULL, &fds_timeout);
+		msecs = (SYNEXEC_COMM_TIMEOUT_SEC * 1000) + (SYNEXEC_COMM_TIMEOUT_USEC / 1000);
 	}
-	if (err == 0){
-		if (verbose > 0){
-			fprintf(stdout, "%s: Select timed out to write on the socket.\n", __FUNCTION__);
-			fflush(stdout);
+
+	// Wait for the socket
+	pfd.fd = sock;
+	pfd.events = events;
+	pfd.revents = 0;
+	return(poll(&pfd, 1, msecs));
+}
+
+/*
+ * static int
+ * _comm_sendv(int sock, struct timeval *timeout, struct iovec *iov,
+ *             int iovcnt);
+ * -------------------------------------------------------------------
+ *  This function sends the 'iovcnt' buffers in 'iov' to the TCP socket
+ *  'sock', which may be non-blocking, gathering them into as few sendmsg()
+ *  calls as the socket allows. Partial writes are resumed where they left
+ *  off. The socket is only waited for when it does not take any more data,
+ *  and if 'timeout' is specified, it will be used. Otherwise the system
+ *  default is used. 'iov' is consumed in the process.
+ *
+ *  Mandatory params: sock, iov, iovcnt
+ *  Optional params : timeout
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Timeout
+ *    n Bytes sent
+ */
+static int
+_comm_sendv(int sock, struct timeval *timeout, struct iovec *iov, int iovcnt){
+	// Local variables
+	struct msghdr           msg;            // Message to send
+	int                     xfer_bytes = 0; // Transfered bytes
+	ssize_t                 i;              // Temporary integer
+	int                     err = 0;        // Return code
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	while (msg.msg_iovlen){
+		// Skip what has been sent already
+		if (msg.msg_iov->iov_len == 0){
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+			continue;
 		}
-		goto out;
-	}else
-	if (err != 1){
-		if (verbose > 0){
-			perror("select");
-			fprintf(stderr, "%s: Error selecting socket to write.\n", __FUNCTION__);
-			fflush(stderr);
+
+		// Send (the rest of) the message, the socket may be non-blocking
+		i = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (i < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+				// Unable to send (whole?) message
+				if (verbose > 0){
+					perror("sendmsg");
+					fprintf(stderr, "%s: Send failed after %d bytes.\n", __FUNCTION__, xfer_bytes);
+					fflush(stderr);
+				}
+				goto err;
+			}
+
+			// Wait for socket to become ready for writing
+			err = comm_poll(sock, POLLOUT, timeout);
+			if (err == 0){
+				if (verbose > 0){
+					fprintf(stdout, "%s: Poll timed out to write on the socket.\n", __FUNCTION__);
+					fflush(stdout);
+				}
+				goto out;
+			}else
+			if ((err < 0) && (errno != EINTR)){
+				if (verbose > 0){
+					perror("poll");
+					fprintf(stderr, "%s: Error polling socket to write.\n", __FUNCTION__);
+					fflush(stderr);
+				}
+				goto err;
+			}
+			continue;
 		}
-		goto err;
-	}
+		xfer_bytes += i;
 
-	// Send the message
-	err = send(sock, data, datalen, 0);
-	if (err != datalen){
-		// Unable to send (whole?) message
-		if (verbose > 0){
-			perror("send");
-			fprintf(stderr, "%s: Send returned %d. Expected %hu.\n", __FUNCTION__, err, datalen);
-			fflush(stderr);
+		// Move past what was sent
+		while (msg.msg_iovlen && ((size_t)i >= msg.msg_iov->iov_len)){
+			i -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen){
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + i;
+			msg.msg_iov->iov_len -= i;
 		}
-		goto err;
 	}
+	err = xfer_bytes;
 
 out:
 	// Return
@@ -196,9 +277,10 @@ err:
  * ----------------------------------------------------------
  *  This function sends a TCP message to 'sock'. It creates the header net_msg
  *  based on 'command', 'data' and 'datalen'. If 'data'/'datalen' are NULL,
- *  only the header is sent (e.g. as in a PROBE).
- *  Upon return, 'timeout' (when specified) will contain the value set by
- *  select() (which can be undefined in case of error).
+ *  only the header is sent (e.g. as in a PROBE). The header and the data are
+ *  sent together (see _comm_sendv()), so a message normally leaves in a
+ *  single segment.
+ *  'timeout' (when specified) applies to each wait on the socket.
  *
  *  Mandatory params: sock, command
  *  Optional params : timeout, data, datalen
@@ -208,15 +290,14 @@ err:
  *  If 'data' or 'datalen' are not specified, only the header is sent.
  *
  * Return values:
- *  -1 Error
- *   0 Select timed out
- *   1 Data sent
+ *  -1 Error (including timeouts)
+ *   n Bytes sent
  */
 int
 comm_send(int sock, char command, struct timeval *timeout, void *data, uint16_t datalen){
 	// Local variables
 	synexec_msg_t           net_msg;        // synexec msg
-	ssize_t                 xfer_bytes;     // Transfered bytes
+	struct iovec            iov[2];         // Header and data
 
 	int                     err = 0;        // Return code
 
@@ -225,25 +306,138 @@ comm_send(int sock, char command, struct timeval *timeout, void *data, uint16_t
 	net_msg.version = MT_SYNEXEC_VERSION;
 	net_msg.session = session;
 	net_msg.command = command;
-	net_msg.datalen = datalen;
+	net_msg.datalen = data?datalen:0;
 	net_msg_hton(&net_msg);
+	iov[0].iov_base = &net_msg;
+	iov[0].iov_len = sizeof(net_msg);
+	iov[1].iov_base = data;
+	iov[1].iov_len = data?datalen:0;
 
 	// Send the message
-	err = _comm_send(sock, timeout, &net_msg, sizeof(net_msg));
-	if (err <= 0){
-		goto err;
+	err = _comm_sendv(sock, timeout, iov, 2);
+	if (err != (int)(sizeof(net_msg) + (data?datalen:0))){
+		err = -1;
 	}
-	xfer_bytes = err;
 
-	if (!datalen){
-		goto out;
+	// Return
+	return(err);
+}
+
+/*
+ * int
+ * comm_cork(int sock, int cork);
+ * ------------------------------
+ *  This function holds partial segments back on 'sock' if 'cork' is set, so
+ *  the pieces of a bulk transfer (a header, then raw data, then a file) go out
+ *  in full segments, and sends whatever is held back once 'cork' is cleared.
+ *  Connections keep TCP_NODELAY for control messages, which are sent whole
+ *  and therefore uncorked.
+ *
+ *  Mandatory params: sock
+ *  Optional params : cork
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+int
+comm_cork(int sock, int cork){
+	if (setsockopt(sock, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork)) < 0){
+		perror("setsockopt");
+		fprintf(stderr, "%s: Error setting TCP_CORK to %d.\n", __FUNCTION__, cork);
+		return(-1);
 	}
+	return(0);
+}
 
-	err = _comm_send(sock, timeout, data, datalen);
-	if (err <= 0){
-		goto err;
+/*
+ * int
+ * comm_send_raw(int sock, struct timeval *timeout, void *data,
+ *               uint16_t datalen);
+ * ------------------------------------------------------------
+ *  This function sends 'datalen' bytes from 'data' to 'sock' without framing
+ *  them in a synexec msg (e.g. following a MT_SYNEXEC_MSG_CONF_STREAM).
+ *  'timeout' (when specified) applies to each wait on the socket.
+ *
+ *  Mandatory params: sock, data, datalen
+ *  Optional params : timeout
+ *
+ * Return values:
+ *  -1 Error (including timeouts)
+ *   n Bytes sent
+ */
+int
+comm_send_raw(int sock, struct timeval *timeout, void *data, uint16_t datalen){
+	// Local variables
+	struct iovec            iov;            // Data
+	int                     err = 0;        // Return code
+
+	if (datalen){
+		iov.iov_base = data;
+		iov.iov_len = datalen;
+		err = _comm_sendv(sock, timeout, &iov, 1);
+		if (err != datalen){
+			err = -1;
+		}
+	}
+
+	// Return
+	return(err);
+}
+
+/*
+ * int
+ * comm_send_stream(int sock, struct timeval *timeout, int fd, uint64_t len);
+ * --------------------------------------------------------------------------
+ *  This function sends 'len' bytes from the current offset of 'fd' to 'sock'
+ *  with sendfile(), without framing them in a synexec msg. It is the
+ *  counterpart of comm_recv_stream().
+ *  'timeout' (when specified) applies to each wait on the socket.
+ *
+ *  Mandatory params: sock, fd, len
+ *  Optional params : timeout
+ *
+ * Return values:
+ *  -1 Error (including timeouts)
+ *   0 Success
+ */
+int
+comm_send_stream(int sock, struct timeval *timeout, int fd, uint64_t len){
+	// Local variables
+	ssize_t                 i;              // Temporary integer
+	int                     err = 0;        // Return code
+
+	while (len){
+		// Wait for socket to become ready for writing
+		i = comm_poll(sock, POLLOUT, timeout);
+		if (i == 0){
+			fprintf(stderr, "%s: Poll timed out with %" PRIu64 " bytes left.\n", __FUNCTION__, len);
+			goto err;
+		}else
+		if (i != 1){
+			if (errno == EINTR){
+				continue;
+			}
+			perror("poll");
+			goto err;
+		}
+
+		// Send straight from the file
+		i = sendfile(sock, fd, NULL, (len < SSIZE_MAX)?len:SSIZE_MAX);
+		if (i < 0){
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EWOULDBLOCK)){
+				continue;
+			}
+			perror("sendfile");
+			fprintf(stderr, "%s: Error streaming file with %" PRIu64 " bytes left.\n", __FUNCTION__, len);
+			goto err;
+		}else
+		if (i == 0){
+			fprintf(stderr, "%s: File ended with %" PRIu64 " bytes left.\n", __FUNCTION__, len);
+			goto err;
+		}
+		len -= i;
 	}
-	xfer_bytes += err;
 
 out:
 	// Return
@@ -254,13 +448,180 @@ err:
 	goto out;
 }
 
+/*
+ * static comm_rbuf_t *
+ * comm_rbuf(int sock, int create);
+ * --------------------------------
+ *  This function returns the receive buffer of 'sock' for the calling thread,
+ *  creating it if 'create' is set.
+ *
+ *  Mandatory params: sock
+ *  Optional params : create
+ *
+ *  Return values:
+ *   NULL Error (or no buffer and 'create' not set)
+ *   *    Receive buffer
+ */
+static comm_rbuf_t *
+comm_rbuf(int sock, int create){
+	// Local variables
+	comm_rbuf_t             **rbufs;        // Grown array of receive buffers
+	int                     nrbufs;         // Size of 'rbufs'
+
+	// Look it up
+	if (sock < 0){
+		return(NULL);
+	}
+	if ((sock < comm_nrbufs) && (comm_rbufs[sock] || !create)){
+		return(comm_rbufs[sock]);
+	}
+	if (!create){
+		return(NULL);
+	}
+
+	// Grow the array to hold it
+	if (sock >= comm_nrbufs){
+		nrbufs = (comm_nrbufs > sock)?comm_nrbufs:(sock + 1);
+		if (nrbufs < comm_nrbufs * 2){
+			nrbufs = comm_nrbufs * 2;
+		}
+		if ((rbufs = realloc(comm_rbufs, nrbufs * sizeof(*rbufs))) == NULL){
+			perror("realloc");
+			fprintf(stderr, "%s: Error allocating receive buffers for %d sockets.\n", __FUNCTION__, nrbufs);
+			return(NULL);
+		}
+		memset(rbufs + comm_nrbufs, 0, (nrbufs - comm_nrbufs) * sizeof(*rbufs));
+		comm_rbufs = rbufs;
+		comm_nrbufs = nrbufs;
+	}
+
+	// Create it
+	if ((comm_rbufs[sock] = malloc(sizeof(comm_rbuf_t))) == NULL){
+		perror("malloc");
+		fprintf(stderr, "%s: Error allocating receive buffer.\n", __FUNCTION__);
+		return(NULL);
+	}
+	comm_rbufs[sock]->off = 0;
+	comm_rbufs[sock]->len = 0;
+	return(comm_rbufs[sock]);
+}
+
+/*
+ * static int
+ * comm_read(int sock, struct timeval *timeout, void *data, size_t datalen);
+ * -------------------------------------------------------------------------
+ *  This function reads whatever is available from 'sock', up to 'datalen'
+ *  bytes, into 'data'. It only waits for the socket (as per 'timeout', or the
+ *  system default) if there is nothing to read yet, so data that is already
+ *  there costs a single system call.
+ *
+ *  Mandatory params: sock, data, datalen
+ *  Optional params : timeout
+ *
+ *  Return values:
+ *   -1 Error (including the connection closing)
+ *    0 Timeout
+ *    n Bytes read
+ */
+static int
+comm_read(int sock, struct timeval *timeout, void *data, size_t datalen){
+	// Local variables
+	ssize_t                 i;              // Temporary integer
+
+	while (1){
+		// Read what is there
+		i = recv(sock, data, datalen, MSG_DONTWAIT);
+		if (verbose > 2){
+			fprintf(stdout, "%s: recv(%d, %p, %lu) = %d\n", __FUNCTION__, sock, data, (unsigned long)datalen, (int)i);
+			fflush(stdout);
+		}
+		if (i > 0){
+			return(i);
+		}else
+		if (i == 0){
+			fprintf(stderr, "%s: Expected to read data but got none\n", __FUNCTION__);
+			fflush(stderr);
+			return(-1);
+		}
+		if (errno == EINTR){
+			continue;
+		}
+		if ((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+			perror("recv");
+			fprintf(stderr, "%s: Read error while reading from socket.\n", __FUNCTION__);
+			fflush(stderr);
+			return(-1);
+		}
+
+		// Wait for the socket to become ready for reading
+		i = comm_poll(sock, POLLIN, timeout);
+		if (i == 0){
+			if (verbose > 1){
+				fprintf(stdout, "%s: Poll timed out.\n", __FUNCTION__);
+				fflush(stdout);
+			}
+			return(0);
+		}else
+		if (i < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			if (verbose > 0){
+				perror("poll");
+				fprintf(stderr, "%s: Poll error while reading from socket.\n", __FUNCTION__);
+				fflush(stderr);
+			}
+			return(-1);
+		}
+	}
+}
+
+/*
+ * static int
+ * comm_fill(int sock, comm_rbuf_t *rbuf, struct timeval *timeout);
+ * ----------------------------------------------------------------
+ *  This function reads as much as fits from 'sock' into its receive buffer
+ *  'rbuf' (see comm_read()), moving the bytes not yet consumed to the front.
+ *
+ *  Mandatory params: sock, rbuf
+ *  Optional params : timeout
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Timeout
+ *    n Bytes read
+ */
+static int
+comm_fill(int sock, comm_rbuf_t *rbuf, struct timeval *timeout){
+	// Local variables
+	int                     i;              // Temporary integer
+
+	// Make room
+	if (rbuf->off){
+		memmove(rbuf->buf, rbuf->buf + rbuf->off, rbuf->len);
+		rbuf->off = 0;
+	}
+	if (rbuf->len == sizeof(rbuf->buf)){
+		return(0);
+	}
+
+	// Read
+	if ((i = comm_read(sock, timeout, rbuf->buf + rbuf->len, sizeof(rbuf->buf) - rbuf->len)) > 0){
+		rbuf->len += i;
+	}
+	return(i);
+}
+
 /*
  * static int
  * _comm_recv(int sock, struct timeval *timeout, void *data, uint16_t datalen);
  * ----------------------------------------------------------------------------
  *  This function reads data from the TCP socket 'sock'. It will read at most
- *  'datalen' bytes from the socket, storing them in 'data'. If 'timeout' is
- *  specified, it will be used. Otherwise the system default is used.
+ *  'datalen' bytes from the socket, storing them in 'data'. Bytes held in the
+ *  receive buffer of 'sock' are consumed first. What is left is read through
+ *  the buffer, unless it is too large to fit, in which case it goes straight
+ *  into 'data'. If 'timeout' is specified, it will be used. Otherwise the
+ *  system default is used.
  *
  *  Mandatory params: sock, data, datalen
  *  Optional params : timeout
@@ -273,81 +634,204 @@ err:
 static int
 _comm_recv(int sock, struct timeval *timeout, void *data, uint16_t datalen){
 	// Local variables
-	fd_set                  fds;            // Select fd_set
-	struct timeval          fds_timeout;    // Select timeout
-	ssize_t                 xfer_bytes = 0; // Transfered bytes
-
+	comm_rbuf_t             *rbuf;          // Receive buffer of 'sock'
+	uint16_t                xfer_bytes = 0; // Transfered bytes
 	int                     i;              // Temporary integer
-	int                     err = 0;        // Return code
 
 	// Validate mandatory arguments
 	if ((sock < 0) || (!data) || (!datalen)){
-		goto err;
+		return(-1);
+	}
+	if ((rbuf = comm_rbuf(sock, 1)) == NULL){
+		return(-1);
 	}
 
-	// Wait for the socket to become ready for reading
-retry:
-	while(datalen){
-		FD_ZERO(&fds);
-		FD_SET(sock, &fds);
-		if (timeout){
-			err = select(sock+1, &fds, NULL, NULL, timeout);
-		}else{
-			fds_timeout.tv_sec  = SYNEXEC_COMM_TIMEOUT_SEC;
-			fds_timeout.tv_usec = SYNEXEC_COMM_TIMEOUT_USEC;
-			err = select(sock+1, &fds, NULL, NULL, &fds_timeout);
+	while (xfer_bytes < datalen){
+		// Consume buffered bytes
+		if (rbuf->len){
+			i = (rbuf->len < (size_t)(datalen - xfer_bytes))?rbuf->len:(datalen - xfer_bytes);
+			memcpy((char *)data + xfer_bytes, rbuf->buf + rbuf->off, i);
+			rbuf->off = (rbuf->len == (size_t)i)?0:(rbuf->off + i);
+			rbuf->len -= i;
+			xfer_bytes += i;
+			continue;
 		}
-		if (err == 0){
-			// Select timed out
-			if (verbose > 1){
-				fprintf(stdout, "%s: Select timed out.\n", __FUNCTION__);
-				fflush(stdout);
+
+		// Read the rest
+		if ((datalen - xfer_bytes) >= (int)sizeof(rbuf->buf)){
+			i = comm_read(sock, timeout, (char *)data + xfer_bytes, datalen - xfer_bytes);
+			if (i > 0){
+				xfer_bytes += i;
 			}
-			break;
+		}else{
+			i = comm_fill(sock, rbuf, timeout);
+		}
+		if (i < 0){
+			return(-1);
 		}else
-		if (err != 1){
-			// Select failed
-			if (errno == EINTR)
-				goto retry;
-			if (verbose > 0){
-				perror("select");
-				fprintf(stderr, "%s: Select error while reading from socket.\n", __FUNCTION__);
-				fflush(stderr);
-			}
-			goto err;
+		if (i == 0){
+			break;
 		}
+	}
 
-		// Receive data
-		memset(data, 0, datalen);
-		i = read(sock, data+xfer_bytes, datalen);
-		if (verbose > 2){
-			fprintf(stdout, "%s: read(%d, %p, %hu) = %d\n", __FUNCTION__, sock, data, datalen, i);
-			fflush(stdout);
+	// Return how many bytes were read
+	return(xfer_bytes);
+}
+
+/*
+ * static void *
+ * comm_alloc();
+ * -------------
+ *  This function hands out a buffer of SYNEXEC_COMM_POOL_BUF bytes for a
+ *  message payload, reusing one of the calling thread that comm_free() put
+ *  back when possible. Buffers beyond SYNEXEC_COMM_POOL are plainly
+ *  allocated.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   NULL Error
+ *   *    Buffer
+ */
+static void *
+comm_alloc(){
+	// Local variables
+	int                     i;              // Temporary integer
+
+	// Reuse a buffer, or take a free slot in the pool
+	for (i=0; i<SYNEXEC_COMM_POOL; i++){
+		if (comm_pool[i] && !comm_pool_used[i]){
+			comm_pool_used[i] = 1;
+			return(comm_pool[i]);
 		}
-		if (i == 0){
-			fprintf(stderr, "%s: Expected to read data but got none\n", __FUNCTION__);
-			fflush(stderr);
-			goto err;
-		} else if (i < 0){
-			perror("read");
-			fprintf(stderr, "%s: Read error while reading from socket.\n", __FUNCTION__);
-			fflush(stderr);
-			goto err;
+	}
+	for (i=0; i<SYNEXEC_COMM_POOL; i++){
+		if (!comm_pool[i]){
+			if ((comm_pool[i] = malloc(SYNEXEC_COMM_POOL_BUF)) != NULL){
+				comm_pool_used[i] = 1;
+			}
+			return(comm_pool[i]);
 		}
-		xfer_bytes += i;
-		datalen -= i;
 	}
+	return(malloc(SYNEXEC_COMM_POOL_BUF));
+}
 
-	// Return how many bytes were read
-	err = xfer_bytes;
+/*
+ * void
+ * comm_free(void *data);
+ * ----------------------
+ *  This function releases a payload returned by comm_recv(), keeping it for
+ *  reuse by the calling thread. Anything else (including NULL) is passed on
+ *  to free(), so buffers that may have been replaced with allocated ones can
+ *  be released alike.
+ *
+ *  Mandatory params:
+ *  Optional params : data
+ *
+ *  Return values:
+ *   None
+ */
+void
+comm_free(void *data){
+	// Local variables
+	int                     i;              // Temporary integer
 
-out:
-	// Return
-	return(err);
+	for (i=0; i<SYNEXEC_COMM_POOL; i++){
+		if (comm_pool[i] == data){
+			comm_pool_used[i] = 0;
+			return;
+		}
+	}
+	free(data);
+}
 
-err:
-	err = -1;
-	goto out;
+/*
+ * int
+ * comm_pending(int sock);
+ * -----------------------
+ *  This function tells whether the receive buffer of 'sock' already holds a
+ *  whole message, which comm_recv() returns without touching the socket.
+ *  Event loops must check it, as the socket itself no longer polls ready for
+ *  such messages.
+ *
+ *  Mandatory params: sock
+ *  Optional params :
+ *
+ *  Return values:
+ *   0 No message buffered
+ *   1 Message buffered
+ */
+int
+comm_pending(int sock){
+	// Local variables
+	comm_rbuf_t             *rbuf;          // Receive buffer of 'sock'
+	synexec_msg_t           net_msg;        // Buffered header
+
+	if (((rbuf = comm_rbuf(sock, 0)) == NULL) || (rbuf->len < sizeof(net_msg))){
+		return(0);
+	}
+	memcpy(&net_msg, rbuf->buf + rbuf->off, sizeof(net_msg));
+	net_msg_ntoh(&net_msg);
+	return(rbuf->len >= (sizeof(net_msg) + net_msg.datalen));
+}
+
+/*
+ * int
+ * comm_close(int sock);
+ * ---------------------
+ *  This function closes 'sock', discarding its receive buffer. Sockets read
+ *  with comm_recv() must be closed with it (by the thread that read them), so
+ *  a socket reusing the descriptor does not inherit stale data.
+ *
+ *  Mandatory params: sock
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+int
+comm_close(int sock){
+	if ((sock >= 0) && (sock < comm_nrbufs) && comm_rbufs[sock]){
+		free(comm_rbufs[sock]);
+		comm_rbufs[sock] = NULL;
+	}
+	return(close(sock));
+}
+
+/*
+ * void
+ * comm_release();
+ * ---------------
+ *  This function frees the receive buffers and the payload pool of the
+ *  calling thread. Threads that use comm_recv() must call it before exiting,
+ *  once their sockets are closed and their payloads released.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+comm_release(){
+	// Local variables
+	int                     i;              // Temporary integer
+
+	for (i=0; i<comm_nrbufs; i++){
+		if (comm_rbufs[i]){
+			free(comm_rbufs[i]);
+		}
+	}
+	free(comm_rbufs);
+	comm_rbufs = NULL;
+	comm_nrbufs = 0;
+	for (i=0; i<SYNEXEC_COMM_POOL; i++){
+		free(comm_pool[i]);
+		comm_pool[i] = NULL;
+		comm_pool_used[i] = 0;
+	}
 }
 
 /*
@@ -357,9 +841,10 @@ err:
  * --------------------------------------------------------------------
  *  This function reads a TCP message from 'sock'. It stores the header in
  *  'net_msg' and any further data in the area pointed to by 'data'
- *  (setting 'datalen' accordingly).
- *  Upon return, 'timeout' (when specified) will contain the value set by
- *  select() (which can be undefined in case of error).
+ *  (setting 'datalen' accordingly). Messages are parsed out of the receive
+ *  buffer of 'sock', which is filled with as much as the socket has at once,
+ *  so messages arriving back to back are read with a single system call.
+ *  'timeout' (when specified) applies to each wait on the socket.
  *
  *  Mandatory params: sock, net_msg
  *  Optional params : timeout, data, datalen
@@ -368,18 +853,23 @@ err:
  *  If 'timeout' is not specified, the netops default will be used.
  *  If 'data' is NULL and we receive net_msg->datalen != 0, this function will
  *  still read (and then discard) the read data. '*data', on the other hand,
- *  should be initially NULL and will be allocated if needed.
- *  '*data' is allocated with malloc() and should be free()d after use.
+ *  should be initially NULL and will be set if needed.
+ *  '*data' comes from a pool of buffers and should be released with
+ *  comm_free() after use. It is always NUL-terminated (one byte past
+ *  'datalen').
  *  If 'datalen' is not specified, it is simply not set.
+ *  A header that does not arrive in full before timing out is kept in the
+ *  receive buffer for the next call.
  *
  * Return values:
  *  -1 Error
- *   0 Select timed out
- *   1 Data read
+ *   0 Poll timed out
+ *   n Bytes read
  */
 int
 comm_recv(int sock, synexec_msg_t *net_msg, struct timeval *timeout, void **data, uint16_t *datalen){
 	// Local variables
+	comm_rbuf_t             *rbuf;          // Receive buffer of 'sock'
 	uint16_t                xfer_bytes = 0; // Bytes actually transferred
 	char                    *_data = NULL;  // Temporary data buffer
 	int                     err = 0;        // Return code
@@ -388,19 +878,24 @@ comm_recv(int sock, synexec_msg_t *net_msg, struct timeval *timeout, void **data
 	if ((sock < 0) || (!net_msg)){
 		goto err;
 	}
+	if ((rbuf = comm_rbuf(sock, 1)) == NULL){
+		goto err;
+	}
 
 	// Receive header
-	err = _comm_recv(sock, timeout, (void *)net_msg, sizeof(*net_msg));
-	if (verbose > 2){
-		fprintf(stderr, "%s: _comm_recv(%d, %p, %p, %lu) = %d\n", __FUNCTION__, sock, timeout, net_msg, (unsigned long)sizeof(*net_msg), err);
-		fflush(stderr);
-	}
-	if (err < 0){
-		goto err;
-	}else
-	if (err == 0){
-		goto out;
+	while (rbuf->len < sizeof(*net_msg)){
+		err = comm_fill(sock, rbuf, timeout);
+		if (err < 0){
+			goto err;
+		}else
+		if (err == 0){
+			goto out;
+		}
 	}
+	memcpy(net_msg, rbuf->buf + rbuf->off, sizeof(*net_msg));
+	rbuf->off += sizeof(*net_msg);
+	rbuf->len -= sizeof(*net_msg);
+	err = sizeof(*net_msg);
 
 	// Validate header
 	net_msg_ntoh(net_msg);
@@ -427,20 +922,21 @@ comm_recv(int sock, synexec_msg_t *net_msg, struct timeval *timeout, void **data
 	if (data == NULL){
 		data = (void **)&_data;
 	}
-	if ((*data = calloc(1, xfer_bytes)) == NULL){
-		perror("calloc");
-		fprintf(stderr, "%s: Error allocating %d bytes for reading buffer.\n", __FUNCTION__, xfer_bytes);
+	if ((*data = comm_alloc()) == NULL){
+		perror("malloc");
+		fprintf(stderr, "%s: Error allocating %d bytes for reading buffer.\n", __FUNCTION__, SYNEXEC_COMM_POOL_BUF);
 		fflush(stderr);
 		goto err;
 	}
-	err = _comm_recv(sock, timeout, *data, xfer_bytes);
-	if (err <= 0){
-		// We cannot afford to tolerate timeouts at this stage, so error out on 0 as well
+	if (_comm_recv(sock, timeout, *data, xfer_bytes) != xfer_bytes){
+		// We cannot afford to tolerate timeouts at this stage, so error out on them as well
 		goto err;
 	}
-
-	// At this point we must have read a header, so count it up
-	err += sizeof(*net_msg);
+	((char *)*data)[xfer_bytes] = '\0';
+	err += xfer_bytes;
+	if (_data){
+		comm_free(_data);
+	}
 
 out:
 	// Return
@@ -449,8 +945,112 @@ out:
 err:
 	err = -1;
 	if (data && *data){
-		free(*data);
+		comm_free(*data);
 		*data = NULL;
 	}
 	goto out;
 }
+
+/*
+ * int
+ * comm_recv_raw(int sock, struct timeval *timeout, void *data,
+ *               uint16_t datalen);
+ * ------------------------------------------------------------
+ *  This function reads exactly 'datalen' bytes that are not framed in a
+ *  synexec msg (e.g. following a MT_SYNEXEC_MSG_CONF_STREAM) from 'sock'
+ *  into 'data'.
+ *  'timeout' (when specified) applies to each wait on the socket.
+ *
+ *  Mandatory params: sock, data, datalen
+ *  Optional params : timeout
+ *
+ * Return values:
+ *  -1 Error (including timeouts)
+ *   n Bytes read
+ */
+int
+comm_recv_raw(int sock, struct timeval *timeout, void *data, uint16_t datalen){
+	// Local variables
+	int                     err = 0;        // Return code
+
+	err = _comm_recv(sock, timeout, data, datalen);
+	if (err != datalen){
+		err = -1;
+	}
+
+	// Return
+	return(err);
+}
+
+/*
+ * int
+ * comm_recv_stream(int sock, struct timeval *timeout, int fd, uint64_t len);
+ * --------------------------------------------------------------------------
+ *  This function reads 'len' bytes that are not framed in a synexec msg from
+ *  'sock' and writes them to 'fd' as they arrive, using a buffer of at most
+ *  SYNEXEC_COMM_STREAM_CHUNK bytes regardless of 'len'. If 'fd' is negative,
+ *  the bytes are read and discarded, which keeps the connection in sync
+ *  when the payload is rejected.
+ *  'timeout' (when specified) applies to each wait on the socket.
+ *
+ *  Mandatory params: sock, len
+ *  Optional params : timeout, fd
+ *
+ * Return values:
+ *  -1 Error (including timeouts)
+ *   0 Success
+ */
+int
+comm_recv_stream(int sock, struct timeval *timeout, int fd, uint64_t len){
+	// Local variables
+	char                    *buf = NULL;    // Transfer buffer
+	uint16_t                chunk;          // Bytes to transfer this round
+	uint16_t                off;            // Bytes of 'chunk' written
+	ssize_t                 i;              // Temporary integer
+	int                     werr = 0;       // Error writing to 'fd'
+	int                     err = 0;        // Return code
+
+	if ((buf = malloc(SYNEXEC_COMM_STREAM_CHUNK)) == NULL){
+		perror("malloc");
+		fprintf(stderr, "%s: Error allocating %d bytes for reading buffer.\n", __FUNCTION__, SYNEXEC_COMM_STREAM_CHUNK);
+		goto err;
+	}
+
+	while (len){
+		chunk = (len < SYNEXEC_COMM_STREAM_CHUNK)?len:SYNEXEC_COMM_STREAM_CHUNK;
+		if (_comm_recv(sock, timeout, buf, chunk) != chunk){
+			fprintf(stderr, "%s: Stream interrupted with %" PRIu64 " bytes left.\n", __FUNCTION__, len);
+			goto err;
+		}
+		len -= chunk;
+
+		// Keep draining the socket after a write error
+		if ((fd < 0) || werr){
+			continue;
+		}
+		for (off = 0; off < chunk; off += i){
+			if ((i = write(fd, buf+off, chunk-off)) < 0){
+				perror("write");
+				fprintf(stderr, "%s: Error writing streamed data.\n", __FUNCTION__);
+				werr = 1;
+				break;
+			}
+		}
+	}
+	if (werr){
+		goto err;
+	}
+
+out:
+	// Free resources
+	if (buf){
+		free(buf);
+	}
+
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	goto out;
+}
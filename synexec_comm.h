@@ -26,12 +26,16 @@
 #define SYNEXEC_COMM_H
 
 // Header files
-#include <sys/select.h>
+#include <sys/time.h>
 #include "synexec_common.h"
 
 // Definitions
 #define SYNEXEC_COMM_TIMEOUT_SEC        1
 #define SYNEXEC_COMM_TIMEOUT_USEC       0
+#define SYNEXEC_COMM_STREAM_CHUNK       32768   // Buffer size when receiving streamed payloads
+#define SYNEXEC_COMM_RECV_BUF           16384   // Receive buffer of each connection
+#define SYNEXEC_COMM_POOL               8       // Payload buffers kept for reuse by each thread
+#define SYNEXEC_COMM_POOL_BUF           65536   // Size of a payload buffer (largest payload and a NUL)
 
 // Function prototypes
 int
@@ -40,7 +44,34 @@ comm_init(uint16_t _net_udpport, char *_net_ifname, char force_bcast);
 int
 comm_send(int sock, char command, struct timeval *timeout, void *data, uint16_t datalen);
 
+int
+comm_cork(int sock, int cork);
+
 int
 comm_recv(int sock, synexec_msg_t *net_msg, struct timeval *timeout, void **data, uint16_t *datalen);
 
+int
+comm_send_raw(int sock, struct timeval *timeout, void *data, uint16_t datalen);
+
+int
+comm_send_stream(int sock, struct timeval *timeout, int fd, uint64_t len);
+
+void
+comm_free(void *data);
+
+int
+comm_pending(int sock);
+
+int
+comm_close(int sock);
+
+void
+comm_release();
+
+int
+comm_recv_raw(int sock, struct timeval *timeout, void *data, uint16_t datalen);
+
+int
+comm_recv_stream(int sock, struct timeval *timeout, int fd, uint64_t len);
+
 #endif /* SYNEXEC_COMM_H */
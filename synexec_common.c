@@ -23,8 +23,15 @@
  */
 
 // Header files
+#include <stdio.h>
 #include <inttypes.h>
 #include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
 #include "synexec_common.h"
 
 // Byte-ordering conversion routines
@@ -41,3 +48,86 @@ net_msg_ntoh(synexec_msg_t *net_msg){
 	net_msg->session = ntohl(net_msg->session);
 	net_msg->datalen = ntohs(net_msg->datalen);
 }
+
+// Time conversion routines
+void
+ts_to_net(struct timespec *ts, synexec_time_t *net_time){
+	net_time->tv_sec  = ts->tv_sec;
+	net_time->tv_nsec = ts->tv_nsec;
+}
+
+void
+net_to_ts(synexec_time_t *net_time, struct timespec *ts){
+	ts->tv_sec  = net_time->tv_sec;
+	ts->tv_nsec = net_time->tv_nsec;
+}
+
+int64_t
+ts_diff_nsec(struct timespec *a, struct timespec *b){
+	return ((int64_t)(a->tv_sec - b->tv_sec) * 1000000000) + (a->tv_nsec - b->tv_nsec);
+}
+
+void
+ts_add_nsec(struct timespec *ts, int64_t nsec){
+	ts->tv_sec  += nsec / 1000000000;
+	ts->tv_nsec += nsec % 1000000000;
+	if (ts->tv_nsec < 0){
+		ts->tv_sec--;
+		ts->tv_nsec += 1000000000;
+	}else
+	if (ts->tv_nsec >= 1000000000){
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+// Run time comparison routine (for qsort() on int64_t arrays)
+int
+int64_cmp(const void *a, const void *b){
+	return((*(int64_t *)a > *(int64_t *)b) - (*(int64_t *)a < *(int64_t *)b));
+}
+
+// Unix socket address routine (fails if 'path' is too long)
+int
+unix_addr(char *path, struct sockaddr_un *addr){
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)){
+		fprintf(stderr, "%s: Error, socket path '%s' is too long.\n", __FUNCTION__, path);
+		return(-1);
+	}
+	strcpy(addr->sun_path, path);
+	return(0);
+}
+
+// Resource usage conversion routines
+void
+ru_to_net(struct rusage *ru, synexec_rusage_t *net_ru){
+	net_ru->utime.tv_sec  = ru->ru_utime.tv_sec;
+	net_ru->utime.tv_nsec = ru->ru_utime.tv_usec * 1000;
+	net_ru->stime.tv_sec  = ru->ru_stime.tv_sec;
+	net_ru->stime.tv_nsec = ru->ru_stime.tv_usec * 1000;
+	net_ru->maxrss  = ru->ru_maxrss;
+	net_ru->minflt  = ru->ru_minflt;
+	net_ru->majflt  = ru->ru_majflt;
+	net_ru->nvcsw   = ru->ru_nvcsw;
+	net_ru->nivcsw  = ru->ru_nivcsw;
+	net_ru->inblock = ru->ru_inblock;
+	net_ru->oublock = ru->ru_oublock;
+}
+
+void
+net_to_ru(synexec_rusage_t *net_ru, struct rusage *ru){
+	memset(ru, 0, sizeof(*ru));
+	ru->ru_utime.tv_sec  = net_ru->utime.tv_sec;
+	ru->ru_utime.tv_usec = net_ru->utime.tv_nsec / 1000;
+	ru->ru_stime.tv_sec  = net_ru->stime.tv_sec;
+	ru->ru_stime.tv_usec = net_ru->stime.tv_nsec / 1000;
+	ru->ru_maxrss  = net_ru->maxrss;
+	ru->ru_minflt  = net_ru->minflt;
+	ru->ru_majflt  = net_ru->majflt;
+	ru->ru_nvcsw   = net_ru->nvcsw;
+	ru->ru_nivcsw  = net_ru->nivcsw;
+	ru->ru_inblock = net_ru->inblock;
+	ru->ru_oublock = net_ru->oublock;
+}
@@ -27,6 +27,12 @@
 
 // Header files
 #include <inttypes.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "synexec_hash.h"
 
 // Global definitions
 #define MT_PROGNAME             "Synchronised Executioner"
@@ -34,7 +40,14 @@
 
 // Program defaults
 #define MT_NETPORT              5165            // Default network port (udp/tcp)
-#define MT_SYNEXEC_VERSION      1
+#define MT_PEERPORT_OFFSET      1               // Slaves serve peers on the network port plus this (tcp)
+#define MT_SYNEXEC_VERSION      2
+
+// Clocks
+#ifndef MT_SYNEXEC_CLOCK_WALL
+#define MT_SYNEXEC_CLOCK_WALL   CLOCK_REALTIME  // Aligned across hosts (may be built with CLOCK_TAI)
+#endif
+#define MT_SYNEXEC_CLOCK_MONO   CLOCK_MONOTONIC // Measures durations, not stepped by NTP
 
 // Available message commands
 #define MT_SYNEXEC_MSG_REPLY    0
@@ -48,10 +61,26 @@
 #define MT_SYNEXEC_MSG_RUNNING  8
 #define MT_SYNEXEC_MSG_STOPPED  9
 #define MT_SYNEXEC_MSG_FINISHD  10
+#define MT_SYNEXEC_MSG_EXEC_AT  11
+#define MT_SYNEXEC_MSG_CONF_STREAM 12
+#define MT_SYNEXEC_MSG_CONF_HASH 13
+#define MT_SYNEXEC_MSG_CONF_MISS 14
+#define MT_SYNEXEC_MSG_FETCH    15
+#define MT_SYNEXEC_MSG_BARRIER  16
+#define MT_SYNEXEC_MSG_BARRIER_OK 17
+#define MT_SYNEXEC_MSG_SIGNAL   18
+#define MT_SYNEXEC_MSG_ABORT    19
+#define MT_SYNEXEC_MSG_OUTPUT   20
+#define MT_SYNEXEC_MSG_TAIL     21
+#define MT_SYNEXEC_MSG_INSTANCES 22
+#define MT_SYNEXEC_MSG_INSTANCE 23
 
 // Configuration token
 #define MT_SYNEXEC_CONF_TOKEN   ":CONF:"
 
+// Longest barrier name (including the terminating NUL)
+#define MT_SYNEXEC_BARRIER_NAME 64
+
 // Network message
 typedef struct {
 	uint32_t        version;
@@ -60,6 +89,110 @@ typedef struct {
 	uint16_t        datalen;
 }__attribute__((packed)) synexec_msg_t;
 
+// Network time value
+typedef struct {
+	int64_t         tv_sec;
+	int64_t         tv_nsec;
+}__attribute__((packed)) synexec_time_t;
+
+// Clock synchronisation sample (MT_SYNEXEC_MSG_PROBE/MT_SYNEXEC_MSG_REPLY)
+typedef struct {
+	synexec_time_t  t1;                     // Master time PROBE was sent
+	synexec_time_t  t2;                     // Slave time PROBE was received
+	synexec_time_t  t3;                     // Slave time REPLY was sent
+}__attribute__((packed)) synexec_sync_t;
+
+// Scheduled execution request (MT_SYNEXEC_MSG_EXEC_AT)
+typedef struct {
+	synexec_time_t  start;                  // Start deadline (slave clock), zero for immediate
+	uint32_t        heartbeat;              // MT_SYNEXEC_MSG_RUNNING interval (msecs), zero for none
+}__attribute__((packed)) synexec_exec_t;
+
+// Streamed payload (MT_SYNEXEC_MSG_CONF_STREAM), followed by 'length' raw bytes
+typedef struct {
+	uint64_t        length;                 // Bytes following the message
+}__attribute__((packed)) synexec_stream_t;
+
+// Configuration digest (MT_SYNEXEC_MSG_CONF_HASH)
+typedef struct {
+	uint8_t         hash[SYNEXEC_HASH_LEN]; // SHA-256 of the whole configuration file
+	uint64_t        length;                 // Length of the configuration file
+}__attribute__((packed)) synexec_conf_t;
+
+// Peer fetch request (MT_SYNEXEC_MSG_FETCH, from master to slave and from slave to peer)
+typedef struct {
+	synexec_conf_t  conf;                   // Configuration to fetch
+	uint32_t        addr;                   // Peer IPv4 address (network order)
+	uint16_t        port;                   // Peer TCP port (network order)
+}__attribute__((packed)) synexec_fetch_t;
+
+// Execution report (MT_SYNEXEC_MSG_EXEC_OK reply to MT_SYNEXEC_MSG_EXEC_AT)
+typedef struct {
+	synexec_time_t  intended;               // Start deadline as requested
+	synexec_time_t  actual;                 // Time the slave actually started
+	synexec_time_t  exec;                   // Time the worker called execv()
+}__attribute__((packed)) synexec_exec_ok_t;
+
+// Worker resource usage (part of MT_SYNEXEC_MSG_FINISHD)
+typedef struct {
+	synexec_time_t  utime;                  // User CPU time
+	synexec_time_t  stime;                  // System CPU time
+	int64_t         maxrss;                 // Maximum resident set size (KiB)
+	int64_t         minflt;                 // Page faults serviced without I/O
+	int64_t         majflt;                 // Page faults that required I/O
+	int64_t         nvcsw;                  // Voluntary context switches
+	int64_t         nivcsw;                 // Involuntary context switches
+	int64_t         inblock;                // Block input operations
+	int64_t         oublock;                // Block output operations
+}__attribute__((packed)) synexec_rusage_t;
+
+// Progress report (MT_SYNEXEC_MSG_RUNNING)
+typedef struct {
+	int64_t         elapsed;                // Run time so far (nsecs, MT_SYNEXEC_CLOCK_MONO)
+	synexec_time_t  utime;                  // User CPU time so far
+	synexec_time_t  stime;                  // System CPU time so far
+	int64_t         rss;                    // Resident set size (KiB)
+}__attribute__((packed)) synexec_running_t;
+
+// Completion report (MT_SYNEXEC_MSG_FINISHD)
+typedef struct {
+	synexec_time_t  time[2];                // 0-started, 1-finished (MT_SYNEXEC_CLOCK_WALL)
+	int64_t         elapsed;                // Run time (nsecs, MT_SYNEXEC_CLOCK_MONO)
+	int32_t         status;                 // Worker wait status
+	synexec_rusage_t rusage;                // Worker resource usage
+}__attribute__((packed)) synexec_finishd_t;
+
+// Barrier (MT_SYNEXEC_MSG_BARRIER, both ways, and MT_SYNEXEC_MSG_BARRIER_OK)
+typedef struct {
+	char            name[MT_SYNEXEC_BARRIER_NAME];// Barrier name (NUL terminated)
+	synexec_time_t  release;                // Release deadline (slave clock), zero for immediate or on entry;
+	                                        // time actually released in MT_SYNEXEC_MSG_BARRIER_OK
+}__attribute__((packed)) synexec_barrier_t;
+
+// Signal delivery (MT_SYNEXEC_MSG_SIGNAL, reported back with MT_SYNEXEC_MSG_STOPPED)
+typedef struct {
+	synexec_time_t  deliver;                // Delivery deadline (slave clock), zero for immediate;
+	                                        // time actually delivered in MT_SYNEXEC_MSG_STOPPED
+	int32_t         signum;                 // Signal to deliver to the task;
+	                                        // minus the errno in MT_SYNEXEC_MSG_STOPPED if it was not delivered
+}__attribute__((packed)) synexec_signal_t;
+
+// Task instances (MT_SYNEXEC_MSG_INSTANCES, applies to the next execution)
+typedef struct {
+	int32_t         count;                  // Instances to run, zero for one per CPU
+	int32_t         pin;                    // Pin each instance to its own CPU
+}__attribute__((packed)) synexec_instances_t;
+
+// Instance completion report (MT_SYNEXEC_MSG_INSTANCE, sent before MT_SYNEXEC_MSG_FINISHD)
+typedef struct {
+	int32_t         index;                  // Instance number, from zero
+	int32_t         cpu;                    // CPU the instance was pinned to, -1 if not pinned
+	synexec_time_t  time[2];                // 0-started, 1-finished (MT_SYNEXEC_CLOCK_WALL)
+	int64_t         elapsed;                // Run time (nsecs, MT_SYNEXEC_CLOCK_MONO)
+	int32_t         status;                 // Instance wait status
+	synexec_rusage_t rusage;                // Instance resource usage
+}__attribute__((packed)) synexec_instance_t;
+
 // Byte-ordering conversion routines
 inline void
 net_msg_hton(synexec_msg_t *net_msg);
@@ -67,4 +200,32 @@ net_msg_hton(synexec_msg_t *net_msg);
 inline void
 net_msg_ntoh(synexec_msg_t *net_msg);
 
+// Time conversion routines
+void
+ts_to_net(struct timespec *ts, synexec_time_t *net_time);
+
+void
+net_to_ts(synexec_time_t *net_time, struct timespec *ts);
+
+int64_t
+ts_diff_nsec(struct timespec *a, struct timespec *b);
+
+void
+ts_add_nsec(struct timespec *ts, int64_t nsec);
+
+// Run time comparison routine
+int
+int64_cmp(const void *a, const void *b);
+
+// Unix socket address routine
+int
+unix_addr(char *path, struct sockaddr_un *addr);
+
+// Resource usage conversion routines
+void
+ru_to_net(struct rusage *ru, synexec_rusage_t *net_ru);
+
+void
+net_to_ru(synexec_rusage_t *net_ru, struct rusage *ru);
+
 #endif /* SYNEXEC_COMMON_H */
@@ -0,0 +1,266 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_hash.c
+ * ----------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+// Header files
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "synexec_hash.h"
+
+// SHA-256 round constants (FIPS 180-4)
+static const uint32_t hash_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR(x, n)       (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * static void
+ * hash_block(synexec_hash_t *ctx, const uint8_t *block);
+ * ------------------------------------------------------
+ *  This function processes one 64 byte 'block' into the state of 'ctx'.
+ *
+ *  Mandatory params: ctx, block
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+hash_block(synexec_hash_t *ctx, const uint8_t *block){
+	// Local variables
+	uint32_t                w[64];                  // Message schedule
+	uint32_t                s[8];                   // Working variables
+	uint32_t                t1, t2;                 // Temporary words
+	int                     i;                      // Temporary integer
+
+	// Prepare the message schedule
+	for (i=0; i<16; i++){
+		w[i] = ((uint32_t)block[i*4] << 24) | ((uint32_t)block[i*4+1] << 16) |
+		       ((uint32_t)block[i*4+2] << 8) | (uint32_t)block[i*4+3];
+	}
+	for (i=16; i<64; i++){
+		t1 = ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10);
+		t2 = ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3);
+		w[i] = t1 + w[i-7] + t2 + w[i-16];
+	}
+
+	// Compress
+	memcpy(s, ctx->state, sizeof(s));
+	for (i=0; i<64; i++){
+		t1 = s[7] + (ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25)) +
+		     ((s[4] & s[5]) ^ (~s[4] & s[6])) + hash_k[i] + w[i];
+		t2 = (ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22)) +
+		     ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		s[7] = s[6];
+		s[6] = s[5];
+		s[5] = s[4];
+		s[4] = s[3] + t1;
+		s[3] = s[2];
+		s[2] = s[1];
+		s[1] = s[0];
+		s[0] = t1 + t2;
+	}
+	for (i=0; i<8; i++){
+		ctx->state[i] += s[i];
+	}
+}
+
+/*
+ * void
+ * hash_init(synexec_hash_t *ctx);
+ * -------------------------------
+ *  This function initialises 'ctx' to compute a new SHA-256 digest.
+ *
+ *  Mandatory params: ctx
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+hash_init(synexec_hash_t *ctx){
+	static const uint32_t   init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memcpy(ctx->state, init, sizeof(ctx->state));
+	ctx->length = 0;
+}
+
+/*
+ * void
+ * hash_update(synexec_hash_t *ctx, const void *data, size_t len);
+ * ---------------------------------------------------------------
+ *  This function adds 'len' bytes from 'data' to the digest in 'ctx'.
+ *
+ *  Mandatory params: ctx, data
+ *  Optional params : len
+ *
+ *  Return values:
+ *   None
+ */
+void
+hash_update(synexec_hash_t *ctx, const void *data, size_t len){
+	// Local variables
+	const uint8_t           *ptr = data;            // Data to hash
+	size_t                  used;                   // Bytes in partial block
+	size_t                  fill;                   // Bytes to copy to partial block
+
+	used = ctx->length % sizeof(ctx->block);
+	ctx->length += len;
+
+	// Complete the partial block
+	if (used){
+		fill = sizeof(ctx->block) - used;
+		if (len < fill){
+			memcpy(ctx->block + used, ptr, len);
+			return;
+		}
+		memcpy(ctx->block + used, ptr, fill);
+		hash_block(ctx, ctx->block);
+		ptr += fill;
+		len -= fill;
+	}
+
+	// Hash full blocks in place
+	while (len >= sizeof(ctx->block)){
+		hash_block(ctx, ptr);
+		ptr += sizeof(ctx->block);
+		len -= sizeof(ctx->block);
+	}
+
+	// Keep the remainder
+	memcpy(ctx->block, ptr, len);
+}
+
+/*
+ * void
+ * hash_final(synexec_hash_t *ctx, uint8_t *digest);
+ * -------------------------------------------------
+ *  This function pads the data hashed in 'ctx' and stores the resulting
+ *  SYNEXEC_HASH_LEN bytes in 'digest'.
+ *
+ *  Mandatory params: ctx, digest
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+hash_final(synexec_hash_t *ctx, uint8_t *digest){
+	// Local variables
+	uint64_t                bits;                   // Message length (bits)
+	uint8_t                 pad[72];                // Padding
+	size_t                  used;                   // Bytes in partial block
+	size_t                  padlen;                 // Bytes of padding
+	int                     i;                      // Temporary integer
+
+	// Pad to 56 bytes modulo 64, then append the length in bits
+	bits = ctx->length * 8;
+	used = ctx->length % sizeof(ctx->block);
+	padlen = (used < 56)?(56 - used):(120 - used);
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for (i=0; i<8; i++){
+		pad[padlen+i] = (uint8_t)(bits >> (56 - i*8));
+	}
+	hash_update(ctx, pad, padlen + 8);
+
+	// Output the state big-endian
+	for (i=0; i<8; i++){
+		digest[i*4]   = (uint8_t)(ctx->state[i] >> 24);
+		digest[i*4+1] = (uint8_t)(ctx->state[i] >> 16);
+		digest[i*4+2] = (uint8_t)(ctx->state[i] >> 8);
+		digest[i*4+3] = (uint8_t)(ctx->state[i]);
+	}
+}
+
+/*
+ * int
+ * hash_fd(int fd, synexec_hash_t *ctx);
+ * -------------------------------------
+ *  This function adds everything that can be read from 'fd' (up to the end of
+ *  file) to the digest in 'ctx'.
+ *
+ *  Mandatory params: fd, ctx
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+int
+hash_fd(int fd, synexec_hash_t *ctx){
+	// Local variables
+	uint8_t                 buf[16384];             // Read buffer
+	ssize_t                 i;                      // Temporary integer
+
+	while ((i = read(fd, buf, sizeof(buf))) != 0){
+		if (i < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			perror("read");
+			fprintf(stderr, "%s: Error reading file to hash.\n", __FUNCTION__);
+			return(-1);
+		}
+		hash_update(ctx, buf, i);
+	}
+
+	return(0);
+}
+
+/*
+ * void
+ * hash_hex(uint8_t *digest, char *hex);
+ * -------------------------------------
+ *  This function writes the SYNEXEC_HASH_LEN bytes of 'digest' to 'hex' as a
+ *  NUL-terminated lowercase hex string (SYNEXEC_HASH_HEXLEN bytes).
+ *
+ *  Mandatory params: digest, hex
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+hash_hex(uint8_t *digest, char *hex){
+	// Local variables
+	int                     i;                      // Temporary integer
+
+	for (i=0; i<SYNEXEC_HASH_LEN; i++){
+		sprintf(hex+(i*2), "%02x", digest[i]);
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_hash.h
+ * ----------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+#ifndef SYNEXEC_HASH_H
+#define SYNEXEC_HASH_H
+
+// Header files
+#include <inttypes.h>
+#include <stddef.h>
+
+// Global definitions
+#define SYNEXEC_HASH_LEN        32              // SHA-256 digest length (bytes)
+#define SYNEXEC_HASH_HEXLEN     (2*SYNEXEC_HASH_LEN+1) // Hex digest length (including NUL)
+
+// SHA-256 context
+typedef struct {
+	uint32_t        state[8];               // Intermediate hash value
+	uint64_t        length;                 // Bytes hashed so far
+	uint8_t         block[64];              // Partial block
+} synexec_hash_t;
+
+// Related functions
+void
+hash_init(synexec_hash_t *ctx);
+
+void
+hash_update(synexec_hash_t *ctx, const void *data, size_t len);
+
+void
+hash_final(synexec_hash_t *ctx, uint8_t *digest);
+
+int
+hash_fd(int fd, synexec_hash_t *ctx);
+
+void
+hash_hex(uint8_t *digest, char *hex);
+
+#endif /* SYNEXEC_HASH_H */
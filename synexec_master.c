@@ -23,10 +23,13 @@
  */
 
 // Header files
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -37,16 +40,52 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <sys/select.h>
+#include <sys/resource.h>
 #include "synexec_common.h"
 #include "synexec_netops.h"
 #include "synexec_comm.h"
 #include "synexec_master_comm.h"
 #include "synexec_master_slaveset.h"
+#include "synexec_master_control.h"
+#include "synexec_master_batch.h"
 
 // Global variables
 uint32_t                session = 0;            // Session ID
 int                     verbose = 0;            // Verbose level
+volatile sig_atomic_t   aborting = 0;           // Abort requested by a signal
+
+// Session parameters
+typedef struct _session_opts_t {
+	int32_t                 slaves;                 // Slaves to wait for
+	char                    *conf_fn;               // Configuration file name
+	uint32_t                start_delay;            // Scheduled start delay (msecs)
+	int                     fanout;                 // Configuration distribution tree arity
+	int                     heartbeat;              // Progress report interval (msecs)
+	int                     timeout;                // Session run time limit (secs)
+	int                     slave_timeout;          // Slave run time limit (secs)
+	double                  straggler;              // Straggler threshold (multiple of the median)
+	char                    partial;                // Accept partial results
+	char                    failfast;               // Abort the session once a task fails
+	int                     iterations;             // Number of executions
+	int                     cooldown;               // Pause between executions (msecs)
+	int                     duration;               // Run time after which tasks are signalled (msecs)
+	int                     signum;                 // Signal delivered after 'duration'
+	int                     instances;              // Task instances per slave, -1 for one per CPU
+	char                    pin;                    // Pin instances to CPUs
+} session_opts_t;
+
+/*
+ * static void
+ * abort_h(int signum);
+ * --------------------
+ *  This is the handler for SIGINT and SIGTERM, which sets the aborting global
+ *  var. The event loop then returns and the session in progress is torn down
+ *  on all slaves (see abort_slaves()).
+ */
+static void
+abort_h(int signum){
+	aborting = 1;
+}
 
 // Print program usage
 static void
@@ -58,18 +97,612 @@ usage(char *argv0){
 	for (i=0; i<MT_PROGNAME_LEN+2; i++) fprintf(stderr, "-");
 	fprintf(stderr, "\n %s\n", MT_PROGNAME);
 	for (i=0; i<MT_PROGNAME_LEN+2; i++) fprintf(stderr, "-");
-	fprintf(stderr, "\nUsage: %s [ -hvd ] [ -i <if_name> ] [ -p <port> ] [-s <session> ] <slaves> <conf>\n", argv0);
+	fprintf(stderr, "\nUsage: %s [ -hvd ] [ -l <log> ] [ -i <if_name> ] [ -p <port> ] [-s <session> ] [ -S <socket> ] [ -O <dir> ] [ -U ]\n"
+	                "       [ -w <msecs> ] [ -k <arity> ] [ -r <msecs> ] [ -t <secs> ] [ -T <secs> ] [ -x <factor> ] [ -P ]\n"
+	                "       [ -F ] [ -n <count> ] [ -c <msecs> ] [ -D <msecs> ] [ -g <signal> ] [ -I <count> ] [ -A ]\n"
+	                "       <slaves> <conf>\n", argv0);
+	fprintf(stderr, "       %s -C <socket> [ session options ] <slaves> <conf>\n", argv0);
 	fprintf(stderr, "       -h             Print this help message and quit.\n");
 	fprintf(stderr, "       -v             Increase verbosity (may be used multiple times).\n");
 	fprintf(stderr, "       -d             Run as daemon. stdout/stderr will be redirect to a log file.\n");
+	fprintf(stderr, "       -l <log>       Log to <log> when running as daemon (default %s).\n", SYNEXEC_MASTER_CONTROL_LOG);
 	fprintf(stderr, "       -i <if_name>   Use interface <if_name> instead of default.\n");
 	fprintf(stderr, "       -b             Force broadcasts to be sent to 255.255.255.255.\n");
 	fprintf(stderr, "       -p <port>      Override default network port (%hu) with <port>.\n", MT_NETPORT);
 	fprintf(stderr, "       -s <session>   Define session ID to <session> (uint32_t, default 0).\n");
+	fprintf(stderr, "       -S <socket>    Keep running and serve sessions submitted on control socket <socket>.\n");
+	fprintf(stderr, "       -O <dir>       Write the output streamed by each slave (synexec_slave -o) to a file in <dir>.\n");
+	fprintf(stderr, "       -U             Send messages addressed to all slaves in batches through io_uring, if available.\n");
+	fprintf(stderr, "       -C <socket>    Submit the session to the master serving control socket <socket>.\n");
+	fprintf(stderr, "       -w <msecs>     Schedule slaves to start together <msecs> after EXEC is sent.\n");
+	fprintf(stderr, "       -k <arity>     Distribute the configuration along a tree of slaves with <arity> children each.\n");
+	fprintf(stderr, "       -r <msecs>     Have slaves report progress every <msecs> while running.\n");
+	fprintf(stderr, "       -t <secs>      Give up on slaves still running <secs> after the session started.\n");
+	fprintf(stderr, "       -T <secs>      Give up on each slave still running <secs> after it started.\n");
+	fprintf(stderr, "       -x <factor>    Flag slaves running longer than <factor> times the median as stragglers.\n");
+	fprintf(stderr, "       -P             Finish with partial results, giving up on stragglers, instead of failing.\n");
+	fprintf(stderr, "       -F             Abort the session on all slaves as soon as a task fails.\n");
+	fprintf(stderr, "       -n <count>     Run the configuration <count> times and print run time statistics.\n");
+	fprintf(stderr, "       -c <msecs>     Wait <msecs> between iterations.\n");
+	fprintf(stderr, "       -D <msecs>     Have all slaves signal their tasks <msecs> after the start.\n");
+	fprintf(stderr, "       -g <signal>    Signal number delivered with -D (default %d, SIGTERM).\n", SIGTERM);
+	fprintf(stderr, "       -I <count>     Run <count> instances of the task on each slave (0 for one per CPU).\n");
+	fprintf(stderr, "       -A             Pin each instance to its own CPU.\n");
 	fprintf(stderr, "       <slaves>       Wait for these many slaves before starting.\n");
 	fprintf(stderr, "       <conf>         Configuration file for this session.\n");
 }
 
+/*
+ * static int
+ * session_opt(int opt, char *arg, session_opts_t *opts, char *argv0);
+ * -------------------------------------------------------------------
+ *  This function parses the session option 'opt' (with argument 'arg') as
+ *  returned by getopt() into 'opts'. These options may be given either on the
+ *  command line or with each session submitted to a persistent master.
+ *
+ *  Mandatory params: opt, opts, argv0
+ *  Optional params : arg
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Option parsed
+ *    1 Not a session option
+ */
+static int
+session_opt(int opt, char *arg, session_opts_t *opts, char *argv0){
+	// Local variables
+	int                     i;                      // Temporary integer
+
+	switch (opt){
+	case 'w':
+		// Set scheduled start delay, if unset (parsed signed, so negative delays do not wrap)
+		if (opts->start_delay != 0){
+			fprintf(stderr, "%s: Error, start delay already set to: %u.\n", argv0, opts->start_delay);
+			return(-1);
+		}else
+		if ((i = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, start delay must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		opts->start_delay = i;
+		break;
+
+	case 'k':
+		// Set distribution tree arity, if unset
+		if (opts->fanout != 0){
+			fprintf(stderr, "%s: Error, tree arity already set to: %d.\n", argv0, opts->fanout);
+			return(-1);
+		}else
+		if ((opts->fanout = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, tree arity must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'r':
+		// Set heartbeat interval, if unset
+		if (opts->heartbeat != 0){
+			fprintf(stderr, "%s: Error, heartbeat interval already set to: %d.\n", argv0, opts->heartbeat);
+			return(-1);
+		}else
+		if ((opts->heartbeat = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, heartbeat interval must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 't':
+		// Set session run time limit, if unset
+		if (opts->timeout != 0){
+			fprintf(stderr, "%s: Error, session timeout already set to: %d.\n", argv0, opts->timeout);
+			return(-1);
+		}else
+		if ((opts->timeout = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, session timeout must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'T':
+		// Set slave run time limit, if unset
+		if (opts->slave_timeout != 0){
+			fprintf(stderr, "%s: Error, slave timeout already set to: %d.\n", argv0, opts->slave_timeout);
+			return(-1);
+		}else
+		if ((opts->slave_timeout = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, slave timeout must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'x':
+		// Set straggler threshold, if unset
+		if (opts->straggler != 0){
+			fprintf(stderr, "%s: Error, straggler factor already set to: %g.\n", argv0, opts->straggler);
+			return(-1);
+		}else
+		if ((opts->straggler = atof(arg)) < 1){
+			fprintf(stderr, "%s: Error, straggler factor must be at least one.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'P':
+		// Accept partial results
+		if (opts->partial == 1){
+			fprintf(stderr, "%s: Error, already set to accept partial results.\n", argv0);
+			return(-1);
+		}
+		opts->partial = 1;
+		break;
+
+	case 'F':
+		// Abort on the first failure
+		if (opts->failfast == 1){
+			fprintf(stderr, "%s: Error, already set to abort on the first failure.\n", argv0);
+			return(-1);
+		}
+		opts->failfast = 1;
+		break;
+
+	case 'n':
+		// Set number of iterations, if unset
+		if (opts->iterations != 0){
+			fprintf(stderr, "%s: Error, iterations already set to: %d.\n", argv0, opts->iterations);
+			return(-1);
+		}else
+		if ((opts->iterations = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, iterations must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'c':
+		// Set cooldown between iterations, if unset
+		if (opts->cooldown != 0){
+			fprintf(stderr, "%s: Error, cooldown already set to: %d.\n", argv0, opts->cooldown);
+			return(-1);
+		}else
+		if ((opts->cooldown = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, cooldown must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'D':
+		// Set run duration, if unset
+		if (opts->duration != 0){
+			fprintf(stderr, "%s: Error, duration already set to: %d.\n", argv0, opts->duration);
+			return(-1);
+		}else
+		if ((opts->duration = atoi(arg)) <= 0){
+			fprintf(stderr, "%s: Error, duration must be greater than zero.\n", argv0);
+			return(-1);
+		}
+		break;
+
+	case 'g':
+		// Set signal delivered after the duration, if unset
+		if (opts->signum != 0){
+			fprintf(stderr, "%s: Error, signal already set to: %d.\n", argv0, opts->signum);
+			return(-1);
+		}else
+		if (((opts->signum = atoi(arg)) <= 0) || (opts->signum >= NSIG)){
+			fprintf(stderr, "%s: Error, signal must be between 1 and %d.\n", argv0, NSIG-1);
+			return(-1);
+		}
+		break;
+
+	case 'I':
+		// Set instances per slave, if unset
+		if (opts->instances != 0){
+			fprintf(stderr, "%s: Error, instances already set to: %d.\n", argv0, opts->instances);
+			return(-1);
+		}else
+		if ((opts->instances = atoi(arg)) < 0){
+			fprintf(stderr, "%s: Error, instances must not be negative.\n", argv0);
+			return(-1);
+		}
+		opts->instances = opts->instances?opts->instances:-1;
+		break;
+
+	case 'A':
+		// Pin instances to CPUs
+		if (opts->pin == 1){
+			fprintf(stderr, "%s: Error, already set to pin instances.\n", argv0);
+			return(-1);
+		}
+		opts->pin = 1;
+		break;
+
+	default:
+		return(1);
+	}
+
+	return(0);
+}
+
+/*
+ * static int
+ * session_args(int argc, char **argv, session_opts_t *opts, char *argv0);
+ * -----------------------------------------------------------------------
+ *  This function parses the remaining arguments of a session, the number of
+ *  slaves and the configuration file name, into 'opts'.
+ *
+ *  Mandatory params: argc, argv, opts, argv0
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+session_args(int argc, char **argv, session_opts_t *opts, char *argv0){
+	if (argc != 2){
+		if (argc > 2){
+			fprintf(stderr, "%s: Error, too many arguments.\n\n", argv0);
+		}
+		usage(argv0);
+		return(-1);
+	}
+	if ((opts->slaves = atoi(argv[0])) <= 0){
+		fprintf(stderr, "%s: Error: number of slaves need to be greater than 0.\n", argv0);
+		return(-1);
+	}
+	if ((opts->conf_fn = strdup(argv[1])) == NULL){
+		perror("strdup");
+		fprintf(stderr, "%s: Error copying configuration file name.\n", argv0);
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * static char *
+ * session_line(session_opts_t *opts);
+ * -----------------------------------
+ *  This function describes the session in 'opts' as a submission for a
+ *  persistent master. The configuration file name is made absolute, as the
+ *  master does not share the working directory of the client.
+ *
+ *  Mandatory params: opts
+ *  Optional params :
+ *
+ *  Return values:
+ *   NULL Error
+ *   Submission line (to be freed by the caller)
+ */
+static char *
+session_line(session_opts_t *opts){
+	// Local variables
+	char                    conf_path[PATH_MAX];    // Absolute configuration file name
+	char                    *line = NULL;           // Submission line
+	size_t                  len = 0;                // Submission line length
+	FILE                    *line_fp;               // Submission line stream
+
+	if (realpath(opts->conf_fn, conf_path) == NULL){
+		perror("realpath");
+		fprintf(stderr, "%s: Error resolving configuration file '%s'.\n", __FUNCTION__, opts->conf_fn);
+		return(NULL);
+	}
+	if (strpbrk(conf_path, " \t\n")){
+		fprintf(stderr, "%s: Error, configuration file '%s' must not contain blanks.\n", __FUNCTION__, conf_path);
+		return(NULL);
+	}
+	if ((line_fp = open_memstream(&line, &len)) == NULL){
+		perror("open_memstream");
+		fprintf(stderr, "%s: Error describing session.\n", __FUNCTION__);
+		return(NULL);
+	}
+
+	// Only pass on the options that were set
+	if (opts->start_delay)   fprintf(line_fp, "-w %u ", opts->start_delay);
+	if (opts->fanout)        fprintf(line_fp, "-k %d ", opts->fanout);
+	if (opts->heartbeat)     fprintf(line_fp, "-r %d ", opts->heartbeat);
+	if (opts->timeout)       fprintf(line_fp, "-t %d ", opts->timeout);
+	if (opts->slave_timeout) fprintf(line_fp, "-T %d ", opts->slave_timeout);
+	if (opts->straggler)     fprintf(line_fp, "-x %g ", opts->straggler);
+	if (opts->partial)       fprintf(line_fp, "-P ");
+	if (opts->failfast)      fprintf(line_fp, "-F ");
+	if (opts->iterations)    fprintf(line_fp, "-n %d ", opts->iterations);
+	if (opts->cooldown)      fprintf(line_fp, "-c %d ", opts->cooldown);
+	if (opts->duration)      fprintf(line_fp, "-D %d ", opts->duration);
+	if (opts->signum)        fprintf(line_fp, "-g %d ", opts->signum);
+	if (opts->instances)     fprintf(line_fp, "-I %d ", (opts->instances < 0)?0:opts->instances);
+	if (opts->pin)           fprintf(line_fp, "-A ");
+	fprintf(line_fp, "%d %s", opts->slaves, conf_path);
+	if (fclose(line_fp) != 0){
+		perror("fclose");
+		fprintf(stderr, "%s: Error describing session.\n", __FUNCTION__);
+		free(line);
+		return(NULL);
+	}
+	return(line);
+}
+
+/*
+ * static int
+ * session_parse(char *line, session_opts_t *opts, session_opts_t *defaults);
+ * --------------------------------------------------------------------------
+ *  This function parses a session submitted to a persistent master. The line
+ *  holds the session options and arguments, as given on the command line.
+ *  Options left unset (or set to zero) are taken from 'defaults'.
+ *
+ *  Mandatory params: line, opts, defaults
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+session_parse(char *line, session_opts_t *opts, session_opts_t *defaults){
+	// Local variables
+	char                    *argv[SYNEXEC_MASTER_CONTROL_ARGS+2];// Submitted arguments
+	int                     argc;                   // Number of arguments
+	int                     i;                      // Temporary integer
+
+	// Split the line, getopt() expects the program name first
+	argv[0] = "session";
+	if ((argc = control_split(line, argv+1, SYNEXEC_MASTER_CONTROL_ARGS)) < 0){
+		return(-1);
+	}
+	argc++;
+
+	// Parse the options
+	memset(opts, 0, sizeof(*opts));
+	optind = 0;
+	while ((i = getopt(argc, argv, "w:k:r:t:T:x:PFn:c:D:g:I:A")) != -1){
+		if (session_opt(i, optarg, opts, argv[0]) != 0){
+			return(-1);
+		}
+	}
+	if (session_args(argc-optind, argv+optind, opts, argv[0]) != 0){
+		return(-1);
+	}
+
+	// Fall back to the options given on the command line
+	opts->start_delay = opts->start_delay?opts->start_delay:defaults->start_delay;
+	opts->fanout = opts->fanout?opts->fanout:defaults->fanout;
+	opts->heartbeat = opts->heartbeat?opts->heartbeat:defaults->heartbeat;
+	opts->timeout = opts->timeout?opts->timeout:defaults->timeout;
+	opts->slave_timeout = opts->slave_timeout?opts->slave_timeout:defaults->slave_timeout;
+	opts->straggler = opts->straggler?opts->straggler:defaults->straggler;
+	opts->partial = opts->partial?opts->partial:defaults->partial;
+	opts->failfast = opts->failfast?opts->failfast:defaults->failfast;
+	opts->iterations = opts->iterations?opts->iterations:defaults->iterations;
+	opts->cooldown = opts->cooldown?opts->cooldown:defaults->cooldown;
+	opts->duration = opts->duration?opts->duration:defaults->duration;
+	opts->signum = opts->signum?opts->signum:defaults->signum;
+	opts->instances = opts->instances?opts->instances:defaults->instances;
+	opts->pin = opts->pin?opts->pin:defaults->pin;
+
+	return(0);
+}
+
+/*
+ * static int
+ * run_session(slaveset_t *slaveset, session_opts_t *opts);
+ * --------------------------------------------------------
+ *  This function runs the session described by 'opts' on 'slaveset': it waits
+ *  for the slaves, configures them, executes the configuration the requested
+ *  number of times and reports the results. Slaves already in the set from a
+ *  previous session are kept, so only missing slaves are discovered.
+ *  If the session fails once the slaves are being configured (or is aborted),
+ *  it is torn down on all of them, killing the tasks still running.
+ *
+ *  Mandatory params: slaveset, opts
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+run_session(slaveset_t *slaveset, session_opts_t *opts){
+	// Local variables
+	int                     conf_fd = -1;           // Configuration file descriptor
+	struct stat             conf_sb;                // Configuration file stats
+	char                    *conf_ptr = NULL;       // Configuration file data pointer
+	int                     iterations;             // Number of executions
+	struct timespec         pause;                  // Pause between executions
+	char                    configured = 0;         // Slaves may hold the configuration
+	int                     i;                      // Temporary integer
+	int                     err = 0;                // Return code
+
+	// Attempt to map configuration file
+	if ((conf_fd = open(opts->conf_fn, O_RDONLY)) < 0){
+		perror("open");
+		fprintf(stderr, "%s: Error opening configuration file '%s' for reading.\n", __FUNCTION__, opts->conf_fn);
+		goto err;
+	}
+	if (fstat(conf_fd, &conf_sb) < 0){
+		perror("fstat");
+		fprintf(stderr, "%s: Error stat'ing configuration file '%s'.\n", __FUNCTION__, opts->conf_fn);
+		goto err;
+	}
+	if (!S_ISREG(conf_sb.st_mode)){
+		fprintf(stderr, "%s: Configuration file '%s' must be a regular file.\n", __FUNCTION__, opts->conf_fn);
+		goto err;
+	}
+	if ((conf_ptr = mmap(0, conf_sb.st_size, PROT_READ, MAP_SHARED, conf_fd, 0)) == MAP_FAILED){
+		perror("mmap");
+		fprintf(stderr, "%s: Error mapping configuration file '%s' to memory.\n", __FUNCTION__, opts->conf_fn);
+		conf_ptr = NULL;
+		goto err;
+	}
+	// Keep 'conf_fd' open, large files are streamed from it with sendfile()
+
+	// Run once if no iterations specified
+	iterations = opts->iterations?opts->iterations:1;
+
+	// Apply the session parameters
+	slaveset->slaves = opts->slaves;
+	slaveset->fanout = opts->fanout;
+	slaveset->heartbeat = opts->heartbeat;
+	slaveset->timeout = opts->timeout;
+	slaveset->slave_timeout = opts->slave_timeout;
+	slaveset->straggler = opts->straggler;
+	slaveset->partial = opts->partial;
+	slaveset->failfast = opts->failfast;
+	slaveset->duration = opts->duration;
+	slaveset->signum = opts->signum?opts->signum:SIGTERM;
+	slaveset->instances = (opts->instances < 0)?0:(opts->instances?opts->instances:1);
+	slaveset->pin = opts->pin;
+
+	// Wait for slaves to join
+	if (wait_slaves(slaveset) != 0){
+		goto err;
+	}
+
+	printf("All %d slaves have joined in. Going into configuration phase.\n", slaveset->active);
+	fflush(stdout);
+
+	// Configure slaves
+	configured = 1;
+	if (config_slaves(slaveset, conf_fd, conf_ptr, conf_sb.st_size) != 0){
+		goto err;
+	}
+
+	printf("All %d slaves are configured. Going into execution phase.\n", slaveset->active);
+	fflush(stdout);
+
+	// Keep the run times of every iteration
+	if ((iterations > 1) && (slaveset_runs(slaveset, iterations) != 0)){
+		goto err;
+	}
+
+	for (i=0; i<iterations; i++){
+		// Let the slaves cool down between iterations
+		if ((i > 0) && opts->cooldown){
+			pause.tv_sec = opts->cooldown / 1000;
+			pause.tv_nsec = (opts->cooldown % 1000) * 1000000;
+			while ((clock_nanosleep(MT_SYNEXEC_CLOCK_MONO, 0, &pause, &pause) != 0) && !aborting);
+			if (aborting){
+				goto err;
+			}
+		}
+
+		// Execute slaves, which keep their configuration between iterations
+		if (execute_slaves(slaveset, opts->start_delay) != 0){
+			goto err;
+		}
+
+		printf("Slaves executing... waiting for them to return.\n");
+		fflush(stdout);
+	
+		// Wait for slaves to finish
+		if (join_slaves(slaveset) != 0){
+			goto err;
+		}
+
+		if (iterations > 1){
+			slaveset_record(slaveset);
+		}
+	}
+
+	slave_times(slaveset);
+	if (iterations > 1){
+		slaveset_stats(slaveset);
+	}
+
+	printf("Session finished.\n");
+	fflush(stdout);
+
+out:
+	// Free local resources
+	if (conf_ptr){
+		munmap(conf_ptr, conf_sb.st_size);
+		conf_ptr = NULL;
+	}
+	if (conf_fd >= 0){
+		close(conf_fd);
+		conf_fd = -1;
+	}
+
+	// Return
+	return(err);
+
+err:
+	// Tear the session down on all slaves
+	if (configured){
+		(void)abort_slaves(slaveset);
+	}
+	err = -1;
+	goto out;
+}
+
+/*
+ * static void
+ * serve(slaveset_t *slaveset, int control_fd, session_opts_t *defaults);
+ * ----------------------------------------------------------------------
+ *  This function implements the persistent master. It runs the sessions
+ *  submitted on 'control_fd' one after the other, keeping the slaves of the
+ *  set connected in between. The output of each session is sent to the client
+ *  that submitted it, followed by a line telling whether the session
+ *  succeeded. A failed session does not stop the master, but SIGINT and
+ *  SIGTERM do, once the session in progress has been aborted.
+ *
+ *  Mandatory params: slaveset, control_fd, defaults
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+serve(slaveset_t *slaveset, int control_fd, session_opts_t *defaults){
+	// Local variables
+	char                    line[SYNEXEC_MASTER_CONTROL_LINE];// Session submission
+	char                    args[SYNEXEC_MASTER_CONTROL_LINE];// Session submission (split)
+	session_opts_t          opts;                   // Submitted session
+	int                     client_fd;              // Client socket
+	int                     out_fd, err_fd;         // Original stdout/stderr
+	int                     err;                    // Session result
+
+	// Clients may go away at any time
+	signal(SIGPIPE, SIG_IGN);
+
+	if (((out_fd = dup(STDOUT_FILENO)) < 0) || ((err_fd = dup(STDERR_FILENO)) < 0)){
+		perror("dup");
+		fprintf(stderr, "%s: Error saving stdout/stderr.\n", __FUNCTION__);
+		return;
+	}
+
+	printf("Serving sessions on the control socket.\n");
+	fflush(stdout);
+
+	while (!aborting){
+		if ((client_fd = control_accept(control_fd, line, sizeof(line))) < 0){
+			continue;
+		}
+
+		// Send the output of the session to the client
+		fflush(stdout);
+		fflush(stderr);
+		dup2(client_fd, STDOUT_FILENO);
+		dup2(client_fd, STDERR_FILENO);
+
+		memset(&opts, 0, sizeof(opts));
+		strcpy(args, line);
+		err = session_parse(args, &opts, defaults);
+		if (err == 0){
+			err = run_session(slaveset, &opts);
+		}
+		free(opts.conf_fn);
+
+		// Tell the client how it went and go back to the log
+		printf("%s\n", (err == 0)?SYNEXEC_MASTER_CONTROL_OK:SYNEXEC_MASTER_CONTROL_FAILED);
+		fflush(stdout);
+		fflush(stderr);
+		dup2(out_fd, STDOUT_FILENO);
+		dup2(err_fd, STDERR_FILENO);
+		close(client_fd);
+
+		printf("Session '%s' %s.\n", line, (err == 0)?"finished":"failed");
+		fflush(stdout);
+	}
+}
+
 // Main
 int
 main(int argc, char **argv){
@@ -77,22 +710,31 @@ main(int argc, char **argv){
 	char                    *net_ifname = NULL;     // Interface name
 	uint16_t                net_port = 0;           // Network port (udp/tcp)
 	char                    daemonize = 0;          // Run as a daemon
+	char                    *log_fn = NULL;         // Daemon log file name
+	int                     log_fd = -1;            // Daemon log file descriptor
 	char                    force_bcast = 0;        // Force bcasts to 255.255.255.255
+	char                    *control_fn = NULL;     // Control socket to serve
+	char                    *submit_fn = NULL;      // Control socket to submit to
+	char                    *output_dir = NULL;     // Task output directory
+	char                    uring = 0;              // Batch messages to all slaves through io_uring
+	int                     control_fd = -1;        // Control socket
+	char                    *line = NULL;           // Session submission
+	session_opts_t          opts;                   // Session given on the command line
 	slaveset_t              slaveset;               // Set of slaves
-	char                    *conf_fn = NULL;        // Configuration file name
-	int                     conf_fd = -1;           // Configuration file descriptor
-	struct stat             conf_sb;                // Configuration file stats
-        char                    *conf_ptr = NULL;       // Configuration file data pointer
+	struct sigaction        sa;                     // Abort signal handler
 
+	struct rlimit           rlim;                   // File descriptor limit
 	int                     i = 0;                  // Temporary integer
 	int                     err = 0;                // Return code
 
 	// Initialise structs
 	memset(&slaveset, 0, sizeof(slaveset));
+	memset(&opts, 0, sizeof(opts));
 	slaveset.slaves = -1;
+	slaveset.epfd = -1;
 
 	// Fetch arguments
-	while ((i = getopt(argc, argv, "hvdi:bp:s:")) != -1){
+	while ((i = getopt(argc, argv, "hvdl:i:bp:s:S:C:O:Uw:k:r:t:T:x:PFn:c:D:g:I:A")) != -1){
 		switch (i){
 		case 'h':
 			// Print help
@@ -122,6 +764,19 @@ main(int argc, char **argv){
 			daemonize = 1;
 			break;
 
+		case 'l':
+			// Set daemon log file, if unset
+			if (log_fn != NULL){
+				fprintf(stderr, "%s: Error, log file already set to '%s'.\n", argv[0], log_fn);
+				goto err;
+			}else
+			if ((log_fn = strdup(optarg)) == NULL){
+				perror("strdup");
+				fprintf(stderr, "%s: Error setting log file.\n", argv[0]);
+				goto err;
+			}
+			break;
+
 		case 'i':
 			// Force interface name, if unset
 			if (net_ifname != NULL){
@@ -159,59 +814,96 @@ main(int argc, char **argv){
 			}
 			break;
 
+		case 'S':
+			// Set control socket to serve, if unset
+			if (control_fn != NULL){
+				fprintf(stderr, "%s: Error, control socket already set to '%s'.\n", argv[0], control_fn);
+				goto err;
+			}else
+			if ((control_fn = strdup(optarg)) == NULL){
+				perror("strdup");
+				fprintf(stderr, "%s: Error setting control socket.\n", argv[0]);
+				goto err;
+			}
+			break;
+
+		case 'O':
+			// Set task output directory, if unset (made absolute, as the daemon leaves the working directory)
+			if (output_dir != NULL){
+				fprintf(stderr, "%s: Error, output directory already set to '%s'.\n", argv[0], output_dir);
+				goto err;
+			}else
+			if ((output_dir = realpath(optarg, NULL)) == NULL){
+				perror("realpath");
+				fprintf(stderr, "%s: Error setting output directory '%s'.\n", argv[0], optarg);
+				goto err;
+			}
+			break;
+
+		case 'U':
+			// Use io_uring for batches
+			if (uring == 1){
+				fprintf(stderr, "%s: Error, io_uring already set.\n", argv[0]);
+				goto err;
+			}
+			uring = 1;
+			break;
+
+		case 'C':
+			// Set control socket to submit to, if unset
+			if (submit_fn != NULL){
+				fprintf(stderr, "%s: Error, control socket already set to '%s'.\n", argv[0], submit_fn);
+				goto err;
+			}else
+			if ((submit_fn = strdup(optarg)) == NULL){
+				perror("strdup");
+				fprintf(stderr, "%s: Error setting control socket.\n", argv[0]);
+				goto err;
+			}
+			break;
+
 		default:
+			// Session options
+			if ((err = session_opt(i, optarg, &opts, argv[0])) < 0){
+				goto err;
+			}
+			if (err == 0){
+				break;
+			}
+
 			// Unknown option
 			fprintf(stderr, "\n");
 			usage(argv[0]);
 			goto err;
 		}
 	}
-	// Check for remaining parameters
-	if (argc != optind+2){
-		if (argc > optind+2){
-			fprintf(stderr, "%s: Error, too many arguments.\n\n", argv[0]);
-		}
-		usage(argv[0]);
-		goto err;
-	}
-	if ((slaveset.slaves = atoi(argv[optind++])) <= 0){
-		fprintf(stderr, "%s: Error: number of slaves need to be greater than 0.\n", argv[0]);
-		goto err;
-	}
-	if ((conf_fn = strdup(argv[optind])) == NULL){
-		perror("strdup");
-		fprintf(stderr, "%s: Error copying configuration file name.\n", argv[0]);
+	if (control_fn && submit_fn){
+		fprintf(stderr, "%s: Error, a master cannot both serve and submit sessions.\n", argv[0]);
 		goto err;
 	}
 
-	// Attempt to map configuration file
-	if ((conf_fd = open(conf_fn, O_RDONLY)) < 0){
-		perror("open");
-		fprintf(stderr, "%s: Error opening configuration file '%s' for reading.\n", argv[0], conf_fn);
-		goto err;
-	}
-	if (fstat(conf_fd, &conf_sb) < 0){
-		perror("fstat");
-		fprintf(stderr, "%s: Error stat'ing configuration file '%s'.\n", argv[0], conf_fn);
-		goto err;
-	}
-	if (!S_ISREG(conf_sb.st_mode)){
-		fprintf(stderr, "%s: Configuration file '%s' must be a regular file.\n", argv[0], conf_fn);
-		goto err;
-	}
-	if ((conf_ptr = mmap(0, conf_sb.st_size, PROT_READ, MAP_SHARED, conf_fd, 0)) == MAP_FAILED){
-		perror("mmap");
-		fprintf(stderr, "%s: Error mapping configuration file '%s' to memory.\n", argv[0], conf_fn);
+	// Check for remaining parameters, a persistent master gets them with each session
+	if (control_fn){
+		if (argc != optind){
+			fprintf(stderr, "%s: Error, sessions are submitted on the control socket.\n\n", argv[0]);
+			usage(argv[0]);
+			goto err;
+		}
+	}else
+	if (session_args(argc-optind, argv+optind, &opts, argv[0]) != 0){
 		goto err;
 	}
-	if (close(conf_fd) < 0){
-		perror("close");
-		fprintf(stderr, "%s: Error closing configuration file '%s' after mapping.\n", argv[0], conf_fn);
-		goto err;
+
+	// Submit the session to a persistent master, if requested
+	if (submit_fn){
+		if ((line = session_line(&opts)) == NULL){
+			goto err;
+		}
+		if (control_submit(submit_fn, line) != 0){
+			goto err;
+		}
+		goto out;
 	}
-	conf_fd = -1;
-	free(conf_fn);
-	conf_fn = NULL;
 
 	// Set default network port if none specified
 	if (net_port == 0){
@@ -230,8 +922,18 @@ main(int argc, char **argv){
 		goto err;
 	}
 
+	// Create the control socket, so it is ready once the daemon is
+	if (control_fn && ((control_fd = control_listen(control_fn)) < 0)){
+		goto err;
+	}
+
 	// Run as daemon, if requested
 	if (daemonize){
+		if ((log_fd = open(log_fn?log_fn:SYNEXEC_MASTER_CONTROL_LOG, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0){
+			perror("open");
+			fprintf(stderr, "%s: Error opening log file '%s'.\n", argv[0], log_fn?log_fn:SYNEXEC_MASTER_CONTROL_LOG);
+			goto err;
+		}
 		i = fork();
 		if (i < 0){
 			perror("fork");
@@ -241,6 +943,8 @@ main(int argc, char **argv){
 		if (i > 0){
 			fprintf(stdout, "%d\n", i);
 			fflush(stdout);
+			close(control_fd);
+			control_fd = -1;
 			goto out;
 		}
 		umask(0);
@@ -250,57 +954,95 @@ main(int argc, char **argv){
 			fprintf(stderr, "%s: Unable to chdir() to \"/\".\n", argv[0]);
 			goto err;
 		}
-		// TODO: Redirect to log
-	}
 
-	// Wait for slaves to join
-	if (wait_slaves(&slaveset) != 0){
-		goto err;
+		// Redirect to log
+		i = open("/dev/null", O_RDONLY);
+		if ((i < 0) || (dup2(i, STDIN_FILENO) < 0) ||
+		    (dup2(log_fd, STDOUT_FILENO) < 0) || (dup2(log_fd, STDERR_FILENO) < 0)){
+			perror("dup2");
+			fprintf(stderr, "%s: Error redirecting stdout/stderr to log file.\n", argv[0]);
+			goto err;
+		}
+		close(i);
+		close(log_fd);
+		log_fd = -1;
 	}
 
-	printf("All %d slaves have joined in. Going into configuration phase.\n", slaveset.slaves);
-	fflush(stdout);
+	// Allow one socket per slave
+	if ((getrlimit(RLIMIT_NOFILE, &rlim) == 0) && (rlim.rlim_cur < rlim.rlim_max)){
+		rlim.rlim_cur = rlim.rlim_max;
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	}
 
-	// Configure slaves
-	if (config_slaves(&slaveset, conf_ptr, conf_sb.st_size) != 0){
+	// Initialise the slave set
+	if (slaveset_init(&slaveset) != 0){
+		goto err;
+	}
+	slaveset.output_dir = output_dir;
+	if (batch_init(uring) != 0){
 		goto err;
 	}
 
-	printf("All %d slaves are configured. Going into execution phase.\n", slaveset.slaves);
-	fflush(stdout);
+	// Abort the session on SIGINT/SIGTERM, interrupting any wait (no SA_RESTART)
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = abort_h;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
 
-	// Execute slaves
-	if (execute_slaves(&slaveset) != 0){
+	// Serve sessions until killed, or run the one given
+	if (control_fn){
+		serve(&slaveset, control_fd, &opts);
 		goto err;
 	}
-
-	printf("Slaves executing... waiting for them to return.\n");
-	fflush(stdout);
-	
-	// Wait for slaves to finish
-	if (join_slaves(&slaveset) != 0){
+	if (run_session(&slaveset, &opts) != 0){
 		goto err;
 	}
 
-	slave_times(&slaveset);
-
-	printf("Session finished.\n");
-	fflush(stdout);
-
 out:
 	// Free local resources
-	if (conf_fd >= 0){
-		close(conf_fd);
-		conf_fd = -1;
+	if (control_fd >= 0){
+		close(control_fd);
+		control_fd = -1;
+		(void)unlink(control_fn);
 	}
-	if (conf_ptr){
-		munmap(conf_ptr, conf_sb.st_size);
-		conf_ptr = NULL;
+	if (control_fn){
+		free(control_fn);
+		control_fn = NULL;
+	}
+	if (submit_fn){
+		free(submit_fn);
+		submit_fn = NULL;
+	}
+	if (log_fn){
+		free(log_fn);
+		log_fn = NULL;
+	}
+	if (log_fd >= 0){
+		close(log_fd);
+		log_fd = -1;
+	}
+	if (line){
+		free(line);
+		line = NULL;
+	}
+	if (opts.conf_fn){
+		free(opts.conf_fn);
+		opts.conf_fn = NULL;
+	}
+	if (slaveset.epfd >= 0){
+		close(slaveset.epfd);
+		slaveset.epfd = -1;
+	}
+	if (slaveset.fleet_runs){
+		free(slaveset.fleet_runs);
+		slaveset.fleet_runs = NULL;
 	}
-	if (conf_fn){
-		free(conf_fn);
-		conf_fn = NULL;
+	if (output_dir){
+		free(output_dir);
+		output_dir = NULL;
 	}
+	batch_exit();
 
 	// Return
 	return(err);
@@ -0,0 +1,472 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_master_batch.c
+ * ------------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+// Header files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include "synexec_common.h"
+#include "synexec_comm.h"
+#include "synexec_master_batch.h"
+
+// Send batches through io_uring if the kernel headers know about it (build with -DSYNEXEC_MASTER_BATCH_URING=0 to leave it out)
+#ifndef SYNEXEC_MASTER_BATCH_URING
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SYNEXEC_MASTER_BATCH_URING     1
+#endif
+#endif
+#endif
+#if SYNEXEC_MASTER_BATCH_URING
+#include <linux/io_uring.h>
+#endif
+
+// Messages queued for a slave
+typedef struct {
+	slave_t                 *slave;                 // Slave to send to
+	uint16_t                len;                    // Bytes queued
+	char                    buf[SYNEXEC_MASTER_BATCH_FRAME];// Messages queued (header and payload)
+} batch_t;
+
+// Global variables
+extern uint32_t                 session;
+extern int                      verbose;
+
+static batch_t                 *batch_queue = NULL;   // Messages queued
+static int                      batch_count = 0;       // Entries used in batch_queue
+static int                      batch_failed = 0;      // Slaves messages failed to reach since the last batch_flush()
+
+#if SYNEXEC_MASTER_BATCH_URING
+static int                      uring_fd = -1;          // io_uring instance, -1 to send with one system call per slave
+static void                     *uring_sq = NULL;       // Submission queue ring
+static size_t                   uring_sq_len = 0;       // Size of uring_sq
+static void                     *uring_cq = NULL;       // Completion queue ring (may be uring_sq)
+static size_t                   uring_cq_len = 0;       // Size of uring_cq
+static struct io_uring_sqe      *uring_sqes = NULL;     // Submission queue entries
+static size_t                   uring_sqes_len = 0;     // Size of uring_sqes
+static struct io_uring_params   uring_params;           // Ring layout
+
+/*
+ * static int
+ * uring_init();
+ * -------------
+ *  This function sets up an io_uring instance with room for a whole batch,
+ *  mapping its rings. Kernels without IORING_FEAT_FAST_POLL (before 5.7) are
+ *  not used, as they may lack IORING_OP_SEND or block the submitter.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error (io_uring unavailable)
+ *    0 Success
+ */
+static int
+uring_init(){
+	// Set the instance up
+	memset(&uring_params, 0, sizeof(uring_params));
+	if ((uring_fd = syscall(__NR_io_uring_setup, SYNEXEC_MASTER_BATCH_SIZE, &uring_params)) < 0){
+		perror("io_uring_setup");
+		goto err;
+	}
+	if (!(uring_params.features & IORING_FEAT_FAST_POLL)){
+		fprintf(stderr, "%s: io_uring is too old to be used.\n", __FUNCTION__);
+		goto err;
+	}
+
+	// Map the rings and the submission queue entries
+	uring_sq_len = uring_params.sq_off.array + (uring_params.sq_entries * sizeof(uint32_t));
+	uring_cq_len = uring_params.cq_off.cqes + (uring_params.cq_entries * sizeof(struct io_uring_cqe));
+	if (uring_params.features & IORING_FEAT_SINGLE_MMAP){
+		if (uring_cq_len > uring_sq_len){
+			uring_sq_len = uring_cq_len;
+		}
+		uring_cq_len = 0;
+	}
+	if ((uring_sq = mmap(NULL, uring_sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                     uring_fd, IORING_OFF_SQ_RING)) == MAP_FAILED){
+		perror("mmap");
+		uring_sq = NULL;
+		goto err;
+	}
+	if (!uring_cq_len){
+		uring_cq = uring_sq;
+	}else
+	if ((uring_cq = mmap(NULL, uring_cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                     uring_fd, IORING_OFF_CQ_RING)) == MAP_FAILED){
+		perror("mmap");
+		uring_cq = NULL;
+		goto err;
+	}
+	uring_sqes_len = uring_params.sq_entries * sizeof(struct io_uring_sqe);
+	if ((uring_sqes = mmap(NULL, uring_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                       uring_fd, IORING_OFF_SQES)) == MAP_FAILED){
+		perror("mmap");
+		uring_sqes = NULL;
+		goto err;
+	}
+	return(0);
+
+err:
+	return(-1);
+}
+
+/*
+ * static void
+ * uring_exit();
+ * -------------
+ *  This function tears down the io_uring instance, if any.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+uring_exit(){
+	if (uring_sqes){
+		munmap(uring_sqes, uring_sqes_len);
+		uring_sqes = NULL;
+	}
+	if (uring_cq && (uring_cq != uring_sq)){
+		munmap(uring_cq, uring_cq_len);
+	}
+	uring_cq = NULL;
+	if (uring_sq){
+		munmap(uring_sq, uring_sq_len);
+		uring_sq = NULL;
+	}
+	if (uring_fd >= 0){
+		close(uring_fd);
+		uring_fd = -1;
+	}
+}
+
+/*
+ * static int
+ * uring_submit(int *sent);
+ * ------------------------
+ *  This function queues a send for each entry of the batch and submits them
+ *  all with one io_uring_enter(), which also waits for their completion. The
+ *  bytes each send took are stored in 'sent' (or -errno on failure, -EAGAIN
+ *  if it was not submitted).
+ *
+ *  Mandatory params: sent
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error (sends may still be in flight)
+ *    0 Success
+ */
+static int
+uring_submit(int *sent){
+	// Local variables
+	uint32_t                *sq_tail;               // Submission queue tail
+	uint32_t                *sq_head;               // Submission queue head
+	uint32_t                sq_mask;                // Submission queue index mask
+	uint32_t                *sq_array;              // Submission queue indices
+	uint32_t                *cq_head;               // Completion queue head
+	uint32_t                *cq_tail;               // Completion queue tail
+	uint32_t                cq_mask;                // Completion queue index mask
+	struct io_uring_cqe     *cqes;                  // Completion queue entries
+	struct io_uring_sqe     *sqe;                   // Submission queue entry
+	struct io_uring_cqe     *cqe;                   // Completion queue entry
+	uint32_t                tail, head;             // Ring positions
+	int                     queued;                 // Sends taken by the kernel (or still to be)
+	int                     done = 0;               // Sends completed
+	int                     i;                      // Temporary integer
+
+	sq_tail = (uint32_t *)((char *)uring_sq + uring_params.sq_off.tail);
+	sq_head = (uint32_t *)((char *)uring_sq + uring_params.sq_off.head);
+	sq_mask = *(uint32_t *)((char *)uring_sq + uring_params.sq_off.ring_mask);
+	sq_array = (uint32_t *)((char *)uring_sq + uring_params.sq_off.array);
+	cq_head = (uint32_t *)((char *)uring_cq + uring_params.cq_off.head);
+	cq_tail = (uint32_t *)((char *)uring_cq + uring_params.cq_off.tail);
+	cq_mask = *(uint32_t *)((char *)uring_cq + uring_params.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *)((char *)uring_cq + uring_params.cq_off.cqes);
+
+	// Queue a send per slave
+	tail = *sq_tail;
+	for (i=0; i<batch_count; i++){
+		sqe = &uring_sqes[tail & sq_mask];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = batch_queue[i].slave->slave_fd;
+		sqe->addr = (uintptr_t)batch_queue[i].buf;
+		sqe->len = batch_queue[i].len;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = i;
+		sq_array[tail & sq_mask] = tail & sq_mask;
+		sent[i] = -EAGAIN;
+		tail++;
+	}
+	__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+	// Submit them and wait for them to complete
+	queued = batch_count;
+	while (done < queued){
+		i = tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+		if ((syscall(__NR_io_uring_enter, uring_fd, i, queued - done, IORING_ENTER_GETEVENTS, NULL, 0) < 0) &&
+		    (errno != EINTR)){
+			perror("io_uring_enter");
+			if (!i){
+				return(-1);
+			}
+
+			// Take back the sends the kernel did not take, they are left to the caller
+			tail -= i;
+			queued -= i;
+			__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+		}
+
+		// Collect the results
+		head = *cq_head;
+		while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)){
+			cqe = &cqes[head & cq_mask];
+			if (cqe->user_data < (uint64_t)batch_count){
+				sent[cqe->user_data] = cqe->res;
+			}
+			head++;
+			done++;
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return(0);
+}
+#endif
+
+/*
+ * static void
+ * batch_submit();
+ * ----------------
+ *  This function sends the messages queued in the batch. With io_uring, the
+ *  whole batch costs one system call, and whatever a send leaves out (a full
+ *  socket) is completed through comm_send_raw(). Otherwise each slave is sent
+ *  its messages with comm_send_raw() directly. Slaves the messages fail to
+ *  reach get 'batch_err' set.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+batch_submit(){
+	// Local variables
+	int                     sent[SYNEXEC_MASTER_BATCH_SIZE];// Bytes sent to each slave
+	batch_t                *entry;                 // Entry of the batch
+	int                     i;                      // Temporary integer
+
+	// Send as much as possible at once
+	memset(sent, 0, sizeof(sent));
+#if SYNEXEC_MASTER_BATCH_URING
+	if (uring_fd >= 0){
+		(void)uring_submit(sent);
+	}
+#endif
+
+	// Send the rest one slave at a time
+	for (i=0; i<batch_count; i++){
+		entry = &batch_queue[i];
+		if (sent[i] < 0){
+			if (verbose > 0){
+				fprintf(stderr, "%s: Batched send to slave (%s:%hu) failed: %s. Retrying.\n", __FUNCTION__,
+					inet_ntoa(entry->slave->slave_addr.sin_addr), ntohs(entry->slave->slave_addr.sin_port),
+					strerror(-sent[i]));
+			}
+			sent[i] = 0;
+		}
+		if ((sent[i] < entry->len) &&
+		    (comm_send_raw(entry->slave->slave_fd, NULL, entry->buf + sent[i], entry->len - sent[i]) < 0)){
+			entry->slave->batch_err = 1;
+			batch_failed++;
+		}
+	}
+	batch_count = 0;
+}
+
+/*
+ * int
+ * batch_init(int uring);
+ * -----------------------
+ *  This function prepares the batch of messages sent to many slaves at once.
+ *  If 'uring' is set, batches are submitted through io_uring, falling back to
+ *  one system call per slave if the kernel does not support it.
+ *
+ *  Mandatory params:
+ *  Optional params : uring
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+int
+batch_init(int uring){
+	if ((batch_queue = malloc(SYNEXEC_MASTER_BATCH_SIZE * sizeof(batch_t))) == NULL){
+		perror("malloc");
+		fprintf(stderr, "%s: Error allocating message batch.\n", __FUNCTION__);
+		return(-1);
+	}
+	batch_count = 0;
+	batch_failed = 0;
+	if (!uring){
+		return(0);
+	}
+#if SYNEXEC_MASTER_BATCH_URING
+	if (uring_init() == 0){
+		if (verbose > 0){
+			printf("%s: Sending to slaves through io_uring.\n", __FUNCTION__);
+		}
+		return(0);
+	}
+	uring_exit();
+#endif
+	fprintf(stderr, "%s: io_uring unavailable, sending to slaves one at a time.\n", __FUNCTION__);
+	return(0);
+}
+
+/*
+ * void
+ * batch_exit();
+ * --------------
+ *  This function releases the batch (see batch_init()).
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+batch_exit(){
+#if SYNEXEC_MASTER_BATCH_URING
+	uring_exit();
+#endif
+	if (batch_queue){
+		free(batch_queue);
+		batch_queue = NULL;
+	}
+	batch_count = 0;
+}
+
+/*
+ * int
+ * batch_send(slave_t *slave, char command, void *data, uint16_t datalen);
+ * -------------------------------------------------------------------------
+ *  This function queues a message for 'slave' in the batch, as comm_send()
+ *  would send it. Messages queued back to back for the same slave are sent
+ *  together, in order. The batch is sent when full or on batch_flush().
+ *  Messages too large for the batch are sent right away, after those queued.
+ *
+ *  Mandatory params: slave, command
+ *  Optional params : data, datalen
+ *
+ *  Return values:
+ *   -1 Error (message not queued)
+ *    0 Success
+ */
+int
+batch_send(slave_t *slave, char command, void *data, uint16_t datalen){
+	// Local variables
+	synexec_msg_t           net_msg;                // Synexec msg
+	batch_t                *entry = NULL;          // Entry to queue the message in
+
+	// Messages that do not fit go straight out
+	if (!data){
+		datalen = 0;
+	}
+	if ((sizeof(net_msg) + datalen) > SYNEXEC_MASTER_BATCH_FRAME){
+		batch_submit();
+		if (comm_send(slave->slave_fd, command, NULL, data, datalen) <= 0){
+			return(-1);
+		}
+		return(0);
+	}
+
+	// Add it to the entry of this slave, or start a new one
+	if (batch_count && (batch_queue[batch_count-1].slave == slave) &&
+	    ((batch_queue[batch_count-1].len + sizeof(net_msg) + datalen) <= SYNEXEC_MASTER_BATCH_FRAME)){
+		entry = &batch_queue[batch_count-1];
+	}else{
+		if (batch_count == SYNEXEC_MASTER_BATCH_SIZE){
+			batch_submit();
+		}
+		entry = &batch_queue[batch_count++];
+		entry->slave = slave;
+		entry->len = 0;
+	}
+
+	// Compose message
+	memset(&net_msg, 0, sizeof(net_msg));
+	net_msg.version = MT_SYNEXEC_VERSION;
+	net_msg.session = session;
+	net_msg.command = command;
+	net_msg.datalen = datalen;
+	net_msg_hton(&net_msg);
+	memcpy(entry->buf + entry->len, &net_msg, sizeof(net_msg));
+	entry->len += sizeof(net_msg);
+	if (datalen){
+		memcpy(entry->buf + entry->len, data, datalen);
+		entry->len += datalen;
+	}
+
+	return(0);
+}
+
+/*
+ * int
+ * batch_flush();
+ * ---------------
+ *  This function sends what is left in the batch. Slaves that any queued
+ *  message failed to reach since the last flush have 'batch_err' set, which
+ *  is left for the caller to clear.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   Number of slaves messages failed to reach
+ */
+int
+batch_flush(){
+	// Local variables
+	int                     failed;                 // Slaves messages failed to reach
+
+	if (batch_count){
+		batch_submit();
+	}
+	failed = batch_failed;
+	batch_failed = 0;
+	return(failed);
+}
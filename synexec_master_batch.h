@@ -0,0 +1,49 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_master_batch.h
+ * ------------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+#ifndef SYNEXEC_MASTER_BATCH_H
+#define SYNEXEC_MASTER_BATCH_H
+
+// Header files
+#include <inttypes.h>
+#include "synexec_master_slaveset.h"
+
+// Global definitions
+#define SYNEXEC_MASTER_BATCH_SIZE     256     // Messages sent per batch (and io_uring submission queue size)
+#define SYNEXEC_MASTER_BATCH_FRAME     256     // Largest message, or run of messages to one slave, in a batch
+
+// Function prototypes
+int
+batch_init(int uring);
+
+void
+batch_exit();
+
+int
+batch_send(slave_t *slave, char command, void *data, uint16_t datalen);
+
+int
+batch_flush();
+
+#endif /* SYNEXEC_MASTER_BATCH_H */
@@ -25,20 +25,38 @@
 // Header files
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <net/if.h>
 #include <arpa/inet.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
 #include "synexec_netops.h"
 #include "synexec_comm.h"
 #include "synexec_common.h"
+#include "synexec_hash.h"
 #include "synexec_master_slaveset.h"
 #include "synexec_master_comm.h"
+#include "synexec_master_batch.h"
+
+// Local functions
+static void
+slave_drop(slaveset_t *slaveset, slave_t *slave);
 
 // Global variables
 extern struct in_addr   net_ifip;
@@ -48,76 +66,392 @@ extern uint16_t         net_port;
 
 extern uint32_t         session;
 extern int              verbose;
+extern volatile sig_atomic_t aborting;
+
+/*
+ * static void
+ * slave_tx_clear(slave_t *slave);
+ * -------------------------------
+ *  This function forgets the message queued on 'slave', either because it was
+ *  sent or because the transfer was given up on, so another can be queued.
+ *
+ *  Mandatory params: slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_tx_clear(slave_t *slave){
+	slave->tx_len = slave->tx_off = 0;
+	slave->tx_data = NULL;
+	slave->tx_datalen = 0;
+	slave->tx_fd = -1;
+}
+
+/*
+ * static int
+ * slave_tx(slaveset_t *slaveset, slave_t *slave);
+ * -----------------------------------------------
+ *  This function writes as much of the message queued on 'slave' as its socket
+ *  accepts without blocking. The header and payload are sent from memory in a
+ *  single sendmsg() and the streamed file (if any) with sendfile(), so it is
+ *  never copied through user space. While the message is incomplete, the
+ *  socket is also watched for EPOLLOUT so the event loop can resume the
+ *  transfer. The socket is uncorked once a streamed file is sent (see
+ *  slave_send()).
+ *
+ *  Mandatory params: slaveset, slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Message partially sent
+ *    1 Message sent
+ */
+static int
+slave_tx(slaveset_t *slaveset, slave_t *slave){
+	// Local variables
+	struct epoll_event      event;                  // epoll registration
+	uint64_t                head;                   // Length of header + payload
+	struct iovec            iov[2];                 // Header and payload left to send
+	struct msghdr           msg;                    // Header and payload message
+	size_t                  len;                    // Length of data to send
+	off_t                   off;                    // Offset in streamed file
+	ssize_t                 i;                      // Temporary integer
+	int                     err = 0;                // Return code
+
+	// Send the header and payload together, then the file
+	head = sizeof(slave->tx_msg) + slave->tx_datalen;
+	while (slave->tx_off < slave->tx_len){
+		if (slave->tx_off < head){
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = iov;
+			if (slave->tx_off < sizeof(slave->tx_msg)){
+				iov[0].iov_base = (char *)&slave->tx_msg + slave->tx_off;
+				iov[0].iov_len = sizeof(slave->tx_msg) - slave->tx_off;
+				iov[1].iov_base = slave->tx_data;
+				iov[1].iov_len = slave->tx_datalen;
+				msg.msg_iovlen = slave->tx_datalen?2:1;
+			}else{
+				iov[0].iov_base = slave->tx_data + (slave->tx_off - sizeof(slave->tx_msg));
+				iov[0].iov_len = head - slave->tx_off;
+				msg.msg_iovlen = 1;
+			}
+			i = sendmsg(slave->slave_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		}else{
+			off = slave->tx_off - head;
+			len = ((slave->tx_len - slave->tx_off) < SSIZE_MAX)?(slave->tx_len - slave->tx_off):SSIZE_MAX;
+			i = sendfile(slave->slave_fd, slave->tx_fd, &off, len);
+		}
+		if (i < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)){
+				break;
+			}
+			perror("send");
+			fprintf(stderr, "%s: Error sending to slave (%s:%hu).\n", __FUNCTION__,
+				inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			goto err;
+		}else
+		if (i == 0){
+			fprintf(stderr, "%s: Streamed file is shorter than expected.\n", __FUNCTION__);
+			goto err;
+		}
+		slave->tx_off += i;
+	}
+
+	// Watch for EPOLLOUT only while there is something left to send
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = slave;
+	if (slave->tx_off < slave->tx_len){
+		event.events |= EPOLLOUT;
+	}else{
+		if (slave->tx_fd >= 0){
+			(void)comm_cork(slave->slave_fd, 0);
+		}
+		slave_tx_clear(slave);
+		err = 1;
+	}
+	if (epoll_ctl(slaveset->epfd, EPOLL_CTL_MOD, slave->slave_fd, &event) < 0){
+		perror("epoll_ctl");
+		fprintf(stderr, "%s: Error updating slave socket in epoll set.\n", __FUNCTION__);
+		goto err;
+	}
+
+out:
+	// Return
+	return(err);
+
+err:
+	// The transfer cannot be resumed
+	slave_tx_clear(slave);
+	err = -1;
+	goto out;
+}
+
+/*
+ * static int
+ * slave_send(slaveset_t *slaveset, slave_t *slave, char command,
+ *            void *data, uint16_t datalen, int fd, uint64_t fdlen);
+ * -----------------------------------------------------------------
+ *  This function queues a message for 'slave' and starts sending it without
+ *  blocking (see slave_tx()). If 'fd' is specified, 'fdlen' bytes from the
+ *  start of that file are streamed after the message, with the socket corked
+ *  so the message and the file fill whole segments. Neither 'data' nor the
+ *  file are copied and must remain valid until the message is sent.
+ *
+ *  Mandatory params: slaveset, slave, command
+ *  Optional params : data, datalen, fd (-1 for none), fdlen
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Message queued
+ *    1 Message sent
+ */
+static int
+slave_send(slaveset_t *slaveset, slave_t *slave, char command, void *data, uint16_t datalen, int fd, uint64_t fdlen){
+	// Only one message can be in flight
+	if (slave->tx_len){
+		fprintf(stderr, "%s: Slave (%s:%hu) still has a message in flight.\n", __FUNCTION__,
+			inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+		return(-1);
+	}
+
+	// Compose message
+	memset(&slave->tx_msg, 0, sizeof(slave->tx_msg));
+	slave->tx_msg.version = MT_SYNEXEC_VERSION;
+	slave->tx_msg.session = session;
+	slave->tx_msg.command = command;
+	slave->tx_msg.datalen = datalen;
+	net_msg_hton(&slave->tx_msg);
+	slave->tx_data = data;
+	slave->tx_datalen = datalen;
+	slave->tx_fd = fd;
+	slave->tx_len = sizeof(slave->tx_msg) + datalen + ((fd >= 0)?fdlen:0);
+	slave->tx_off = 0;
+	if (fd >= 0){
+		(void)comm_cork(slave->slave_fd, 1);
+	}
+
+	// Send as much as possible
+	return(slave_tx(slaveset, slave));
+}
+
+/*
+ * static int
+ * slave_send_conf(slaveset_t *slaveset, slave_t *slave);
+ * ------------------------------------------------------
+ *  This function starts sending the configuration file of 'slaveset' to
+ *  'slave'. Files that do not fit in a synexec msg are streamed with a
+ *  MT_SYNEXEC_MSG_CONF_STREAM.
+ *
+ *  Mandatory params: slaveset, slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Configuration queued
+ *    1 Configuration sent
+ */
+static int
+slave_send_conf(slaveset_t *slaveset, slave_t *slave){
+	if (slaveset->conf_len > UINT16_MAX){
+		return(slave_send(slaveset, slave, MT_SYNEXEC_MSG_CONF_STREAM, &slaveset->conf_stream,
+		                  sizeof(slaveset->conf_stream), slaveset->conf_fd, slaveset->conf_len));
+	}
+	return(slave_send(slaveset, slave, MT_SYNEXEC_MSG_CONF, slaveset->conf_ptr, slaveset->conf_len, -1, 0));
+}
+
+/*
+ * static void
+ * slave_conf_source(slaveset_t *slaveset, slave_t *slave);
+ * --------------------------------------------------------
+ *  This function provides the configuration file to 'slave', which does not
+ *  have it cached. If the distribution tree is enabled and the parent of
+ *  'slave' already has the file, 'slave' is told to fetch it from there. If
+ *  the parent is still getting the file, 'slave' waits for it. Otherwise (no
+ *  tree, top of the tree, parent failed or fetching from it failed) the master
+ *  sends the file itself.
+ *
+ *  Mandatory params: slaveset, slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_conf_source(slaveset_t *slaveset, slave_t *slave){
+	// Local variables
+	slave_t                 *parent = NULL;         // Parent in the distribution tree
+
+	// Find the parent, unless fetching from it already failed
+	if (slaveset->tree && (slave->conf_miss == 0) && (slave->tree_index >= slaveset->fanout)){
+		parent = slaveset->tree[(slave->tree_index / slaveset->fanout) - 1];
+	}
+
+	if (parent && (parent->state == SLAVE_STATE_CONF)){
+		// Wait for the parent to get it
+		slave->conf_wait = 1;
+	}else
+	if (parent && (parent->state == SLAVE_STATE_READY)){
+		// Fetch from the parent
+		if (verbose > 1){
+			printf("%s: Slave (%s:%hu) will fetch the configuration from a peer.\n", __FUNCTION__,
+				inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			fflush(stdout);
+		}
+		slave->conf_miss = 2;
+		slave->fetch.conf = slaveset->conf;
+		slave->fetch.addr = parent->slave_addr.sin_addr.s_addr;
+		slave->fetch.port = htons(net_port + MT_PEERPORT_OFFSET);
+		if (slave_send(slaveset, slave, MT_SYNEXEC_MSG_FETCH, &slave->fetch, sizeof(slave->fetch), -1, 0) < 0){
+			slave_drop(slaveset, slave);
+		}
+	}else{
+		// Send it from the master
+		slave->conf_miss = 1;
+		if (slave_send_conf(slaveset, slave) < 0){
+			slave_drop(slaveset, slave);
+		}
+	}
+}
+
+/*
+ * static void
+ * slave_conf_children(slaveset_t *slaveset, slave_t *slave);
+ * ----------------------------------------------------------
+ *  This function is called once 'slave' accepted (or failed to get) the
+ *  configuration file. Its children in the distribution tree that are waiting
+ *  for it are given a source for the file (see slave_conf_source()).
+ *
+ *  Mandatory params: slaveset, slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_conf_children(slaveset_t *slaveset, slave_t *slave){
+	// Local variables
+	slave_t                 *child;                 // Child in the distribution tree
+	int                     i;                      // Temporary integer
+
+	for (i=(slave->tree_index+1)*slaveset->fanout; i<(slave->tree_index+2)*slaveset->fanout; i++){
+		if (i >= slaveset->tree_len){
+			break;
+		}
+		child = slaveset->tree[i];
+		if (child && child->conf_wait){
+			child->conf_wait = 0;
+			slave_conf_source(slaveset, child);
+		}
+	}
+}
+
+/*
+ * static void
+ * slave_drop(slaveset_t *slaveset, slave_t *slave);
+ * -------------------------------------------------
+ *  This function closes the connection to 'slave' and marks it as dead, so it
+ *  is removed from 'slaveset' by the next slaveset_purge(). If the slave had
+ *  was expected to complete the current step, the step is accounted as failed.
+ *  Slaves waiting to fetch the configuration from it are served elsewhere.
+ *
+ *  Mandatory params: slaveset, slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_drop(slaveset_t *slaveset, slave_t *slave){
+	if (verbose > 0){
+		printf("%s: Dropping slave (%s:%hu).\n", __FUNCTION__,
+			inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+		fflush(stdout);
+	}
+
+	// Account for the step in progress
+	if (slave->joined){
+		slaveset->active--;
+	}
+	if ((slave->state == SLAVE_STATE_PROBE) ||
+	    (slave->state == SLAVE_STATE_CONF) ||
+	    (slave->state == SLAVE_STATE_RUNNING)){
+		slaveset->pending--;
+		slaveset->failed++;
+	}
+
+	// Close its socket (which also removes it from the epoll set)
+	if (slave->slave_fd >= 0){
+		(void)comm_close(slave->slave_fd);
+		slave->slave_fd = -1;
+	}
+	slave_tx_clear(slave);
+	slave->state = SLAVE_STATE_DEAD;
+
+	// Its children in the distribution tree need another source
+	if (slaveset->tree){
+		slaveset->tree[slave->tree_index] = NULL;
+		slave_conf_children(slaveset, slave);
+	}
+}
 
 /*
  * static int
- * comm_tcp_accept(int sock, struct timeval *timeout, slaveset_t *slaveset);
- * -------------------------------------------------------------------------
- *  This function accepts TCP connections from slaves and inserts them into
- *  'slaveset'.
+ * comm_tcp_accept(int sock, slaveset_t *slaveset);
+ * ------------------------------------------------
+ *  This function accepts a TCP connection from a slave and inserts it into
+ *  'slaveset'. The slave hello is processed by the event loop.
  * 
  *  Mandatory params: sock, slaveset
- *  Optional params : timeout
- *
- *  NOTES:
- *  If 'timeout' is not specified, the function may wait forever.
+ *  Optional params :
  *
  *  Return values:
  *   -1: Error
- *    0: Timeout while waiting
+ *    0: No connection pending
  *    1: One slave added
  */
 static int
-comm_tcp_accept(int sock, struct timeval *timeout, slaveset_t *slaveset){
+comm_tcp_accept(int sock, slaveset_t *slaveset){
 	// Local variables
-	fd_set                  fds;                    // Select fd_set
 	int                     slave_sock = -1;        // Socket to accept new slaves
 	struct sockaddr_in      slave_addr;             // Slave's address
 	socklen_t               slave_len;              // Address length
-	synexec_msg_t           net_msg;                // synexec msg
+	int                     i;                      // Temporary integer
 	int                     err = 0;                // Return code
 
-	// Wait until there is something to read
-	FD_ZERO(&fds);
-	FD_SET(sock, &fds);
-	err = select(sock+1, &fds, NULL, NULL, timeout);
-	if (err == -1){
-		perror("select");
-		fprintf(stderr, "%s: Error waiting to receive response from slaves.\n", __FUNCTION__);
-		goto out;
-	}else
-	if (err == 0){
-		goto out;
-	}
-
 	// There is a connection on the pipe
 	slave_len = sizeof(slave_addr);
-	if ((slave_sock = accept(sock, (struct sockaddr *)&slave_addr, &slave_len)) < 0){
+	if ((slave_sock = accept4(sock, (struct sockaddr *)&slave_addr, &slave_len, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0){
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)){
+			goto out;
+		}
 		perror("accept");
 		fprintf(stderr, "%s: Error accepting new connection.\n", __FUNCTION__);
 		goto err;
 	}
+	i = 1; // TCP_NODELAY = true, so timestamped probes are not held back by Nagle
+	if (setsockopt(slave_sock, IPPROTO_TCP, TCP_NODELAY, &i, sizeof(i)) < 0){
+		perror("setsockopt");
+		fprintf(stderr, "%s: Error setting TCP_NODELAY to slave socket.\n", __FUNCTION__);
+	}
 	if (verbose > 0){
 		printf("%s: Accepted connection from '%s:%hu'.\n", __FUNCTION__,
 			inet_ntoa(slave_addr.sin_addr), ntohs(slave_addr.sin_port));
 		fflush(stdout);
 	}
 
-        // Process hello
-	if (comm_recv(slave_sock, &net_msg, NULL, NULL, NULL) <= 0){
-		(void)close(slave_sock);
-		err = 0;
-		goto out;
-	}
-	if (net_msg.command != MT_SYNEXEC_MSG_REPLY){
-		(void)close(slave_sock);
-		err = 0;
-		goto out;
-	}
-
 	// Add the connection to the slaveset
 	err = slave_add(slaveset, &slave_addr, slave_sock);
-	if (err && (verbose > 1)){
+	if (err == 0){
+		(void)close(slave_sock);
+	}else
+	if ((err > 0) && (verbose > 1)){
 		printf("%s: Added slave: %s:%hu (%d).\n", __FUNCTION__,
 			inet_ntoa(slave_addr.sin_addr), ntohs(slave_addr.sin_port), slave_sock);
 		fflush(stdout);
@@ -148,8 +482,7 @@ err:
 static int
 comm_udp_broadcast(int sock){
 	// Local variables
-	fd_set                  fds;                    // Select fd_set
-	struct timeval          fds_timeout;            // Select timeout;
+	struct pollfd           pfd;                    // Poll descriptor
 	struct sockaddr_in      net_udpaddr;            // Sock addr for sending
 	synexec_msg_t           net_msg;                // synexec msg
 
@@ -157,14 +490,13 @@ comm_udp_broadcast(int sock){
 	int                     err = 0;                // Return code
 
 	// Ensure socket is ready to send
-	FD_ZERO(&fds);
-	FD_SET(sock, &fds);
-	fds_timeout.tv_sec = 1;
-	fds_timeout.tv_usec = 0;
-	i = select(sock+1, NULL, &fds, NULL, &fds_timeout);
+	pfd.fd = sock;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	i = poll(&pfd, 1, 1000);
 	if (i != 1){
 		if (i != 0){
-			perror("select");
+			perror("poll");
 		}
 		fprintf(stderr, "%s: UDP Broadcast socket not ready to transmit in time.\n", __FUNCTION__);
 		goto err;
@@ -200,83 +532,771 @@ err:
 }
 
 /*
- * int
- * slave_fd_probe(int sock);
- * -------------------------
- *  Probe the slave at the other end of 'sock'.
+ * static int
+ * slaveset_flush(slaveset_t *slaveset);
+ * -------------------------------------
+ *  This function sends the messages batched for the slaves in 'slaveset' (see
+ *  batch_send()) and drops the slaves they failed to reach.
  *
- *  Mandatory params: sock
+ *  Mandatory params: slaveset
  *  Optional params :
  *
  *  Return values:
+ *   Number of slaves dropped
+ */
+static int
+slaveset_flush(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	int                     dropped = 0;            // Slaves dropped
+
+	if (batch_flush() == 0){
+		return(0);
+	}
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->batch_err){
+			slave->batch_err = 0;
+			if (slave->state != SLAVE_STATE_DEAD){
+				slave_drop(slaveset, slave);
+				dropped++;
+			}
+		}
+		slave = slave->next;
+	}
+	return(dropped);
+}
+
+/*
+ * int
+ * slave_probe(slave_t *slave_aux, int batch);
+ * -------------------------------------------
+ *  Send a timestamped probe to 'slave_aux'. The reply is processed by the
+ *  event loop (see slave_sync()). If 'batch' is set, the probe is queued with
+ *  batch_send() instead, so it is only sent on batch_flush(). The time it
+ *  waits there only widens the error bound of that sample, and the best
+ *  sample of the round is kept.
+ *
+ *  Mandatory params: slave_aux
+ *  Optional params : batch
+ *
+ *  Return values:
  *   -1 Error
  *    0 Success
  */
 int
-slave_fd_probe(int sock){
+slave_probe(slave_t *slave_aux, int batch){
 	// Local variables
-	synexec_msg_t           net_msg;                // synexec msg
+	struct timespec         now;                    // Current time
+	synexec_time_t          t1;                     // Current time (marshalled)
 	int                     err = 0;                // Return code
 
-	// Probe the slave
-	if (comm_send(sock, MT_SYNEXEC_MSG_PROBE, NULL, NULL, 0) <= 0){
-		goto err;
-	}
+	if (verbose > 1){
+		printf("%s: Probing slave (%s:%hu).\n", __FUNCTION__,
+			inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
+	}
+
+	// Probe the slave
+	clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	ts_to_net(&now, &t1);
+	if (batch){
+		err = batch_send(slave_aux, MT_SYNEXEC_MSG_PROBE, &t1, sizeof(t1));
+	}else
+	if (comm_send(slave_aux->slave_fd, MT_SYNEXEC_MSG_PROBE, NULL, &t1, sizeof(t1)) <= 0){
+		if (verbose > 0){
+			printf("%s: Error probing slave (%s:%hu).\n", __FUNCTION__,
+				inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
+		}
+		goto err;
+	}
+
+out:
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	goto out;
+}
+
+/*
+ * static int
+ * slave_sync(slave_t *slave, synexec_msg_t *net_msg, char *data,
+ *            struct timespec *recv_time);
+ * ---------------------------------------------------------------
+ *  This function processes the reply to a timestamped probe, received at
+ *  'recv_time'. It estimates the offset of the slave clock in the same way as
+ *  NTP: the offset is ((t2-t1)+(t3-t4))/2 and the error bound is half the
+ *  round trip delay ((t4-t1)-(t3-t2))/2. Of the SYNEXEC_MASTER_COMM_SYNC_ROUNDS
+ *  probes sent by the event loop, the one with the smallest delay is kept in
+ *  'slave->clock_offset/clock_error'.
+ *
+ *  Mandatory params: slave, net_msg, recv_time
+ *  Optional params : data
+ *
+ *  Return values:
+ *   0 Slave did not timestamp its reply
+ *   1 Sample processed
+ */
+static int
+slave_sync(slave_t *slave, synexec_msg_t *net_msg, char *data, struct timespec *recv_time){
+	// Local variables
+	synexec_sync_t          sync;                   // Clock synchronisation sample
+	struct timespec         t[4];                   // Sample timestamps
+	int64_t                 offset;                 // Sample offset (nsecs)
+	int64_t                 error;                  // Sample error bound (nsecs)
+
+	// Skip slaves that do not timestamp their replies
+	if (net_msg->datalen != sizeof(sync)){
+		return(0);
+	}
+	memcpy(&sync, data, sizeof(sync));
+	net_to_ts(&sync.t1, &t[0]);
+	net_to_ts(&sync.t2, &t[1]);
+	net_to_ts(&sync.t3, &t[2]);
+	t[3] = *recv_time;
+
+	// Keep the sample with the shortest round trip
+	offset = (ts_diff_nsec(&t[1], &t[0]) + ts_diff_nsec(&t[2], &t[3])) / 2;
+	error  = (ts_diff_nsec(&t[3], &t[0]) - ts_diff_nsec(&t[2], &t[1])) / 2;
+	if ((slave->probes == SYNEXEC_MASTER_COMM_SYNC_ROUNDS) || (error < slave->clock_error)){
+		slave->clock_offset = offset;
+		slave->clock_error = error;
+	}
+
+	return(1);
+}
+
+/*
+ * static void
+ * slaveset_barrier(slaveset_t *slaveset);
+ * ---------------------------------------
+ *  This function releases a barrier once every running slave has reached it.
+ *  Slaves that finished (or were given up on) no longer count, so they do not
+ *  hold the others back. As for the start, all slaves are given the same
+ *  deadline ('slaveset->start_delay' msecs from now, translated to each slave
+ *  clock) and release their tasks once it is reached. Without a start delay,
+ *  slaves release their tasks as soon as they are told.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slaveset_barrier(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	synexec_barrier_t       barrier;                // Barrier release
+	struct timespec         release;                // Release deadline
+	int                     running = 0;            // Slaves running
+	int                     arrived = 0;            // Slaves waiting on the barrier
+
+	// Check that all running slaves wait on the same barrier
+	memset(&barrier, 0, sizeof(barrier));
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state == SLAVE_STATE_RUNNING){
+			running++;
+			if (slave->barrier[0]){
+				if (!barrier.name[0]){
+					strcpy(barrier.name, slave->barrier);
+				}
+				if (!strcmp(barrier.name, slave->barrier)){
+					arrived++;
+				}
+			}
+		}
+		slave = slave->next;
+	}
+	if (!arrived || (arrived < running)){
+		return;
+	}
+
+	// Work out the release deadline
+	memset(&release, 0, sizeof(release));
+	if (slaveset->start_delay){
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &release);
+		ts_add_nsec(&release, (int64_t)slaveset->start_delay * 1000000);
+	}
+	strcpy(slaveset->barrier, barrier.name);
+	slaveset->barrier_time = release;
+	slaveset->barrier_acks = 0;
+
+	printf("Barrier '%s' reached by %d slaves, releasing.\n", barrier.name, arrived);
+	fflush(stdout);
+
+	// Release the slaves
+	slave = slaveset->slave;
+	while (slave){
+		if ((slave->state == SLAVE_STATE_RUNNING) && !strcmp(barrier.name, slave->barrier)){
+			slave->barrier[0] = 0;
+			if (slaveset->start_delay){
+				ts_add_nsec(&release, slave->clock_offset);
+				ts_to_net(&release, &barrier.release);
+				ts_add_nsec(&release, -slave->clock_offset);
+			}
+			if (batch_send(slave, MT_SYNEXEC_MSG_BARRIER, &barrier, sizeof(barrier)) < 0){
+				slave_drop(slaveset, slave);
+			}else{
+				slaveset->barrier_acks++;
+			}
+		}
+		slave = slave->next;
+	}
+	slaveset->barrier_acks -= slaveset_flush(slaveset);
+}
+
+/*
+ * static void
+ * slave_output(slaveset_t *slaveset, slave_t *slave, char *data, int len);
+ * -----------------------------------------------------------------------
+ *  This function writes 'len' bytes of task output streamed by 'slave'. If
+ *  'slaveset->output_dir' is set, the output goes to a file named after the
+ *  slave address in that directory, which is opened on first use and
+ *  appended to. Otherwise, it is printed to stdout with every line prefixed
+ *  by the slave address, so the output of all slaves can be told apart.
+ *
+ *  Mandatory params: slaveset, slave, data
+ *  Optional params : len
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_output(slaveset_t *slaveset, slave_t *slave, char *data, int len){
+	// Local variables
+	char                    fn[PATH_MAX];           // Output file name
+	char                    *eol;                   // End of the current line
+	int                     n;                      // Bytes in the current line
+
+	// Write to the output file of the slave
+	if (slaveset->output_dir){
+		if (!slave->out_fp){
+			snprintf(fn, sizeof(fn), "%s/%s_%hu.out", slaveset->output_dir,
+			         inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			if ((slave->out_fp = fopen(fn, "a")) == NULL){
+				perror("fopen");
+				fprintf(stderr, "%s: Error opening output file '%s'. Output of slave discarded.\n", __FUNCTION__, fn);
+				return;
+			}
+		}
+		if ((fwrite(data, 1, len, slave->out_fp) != len) || (fflush(slave->out_fp) != 0)){
+			perror("fwrite");
+			fprintf(stderr, "%s: Error writing output of slave (%s:%hu).\n", __FUNCTION__,
+			        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+		}
+		return;
+	}
+
+	// Print it line by line, prefixed by the slave
+	while (len > 0){
+		eol = memchr(data, '\n', len);
+		n = eol?(eol-data+1):len;
+		if (!slave->out_partial){
+			printf("[%s:%hu] ", inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+		}
+		fwrite(data, 1, n, stdout);
+		slave->out_partial = !eol;
+		data += n;
+		len -= n;
+	}
+	fflush(stdout);
+}
+
+/*
+ * static int
+ * slave_failed(slaveset_t *slaveset, int status);
+ * -----------------------------------------------
+ *  This function tells whether a task that finished with wait status 'status'
+ *  failed. Tasks stopped by the signal the session delivers after
+ *  'slaveset->duration' did not, whether killed by it or, when supervising
+ *  several instances, exiting with 128 plus its number.
+ *
+ *  Mandatory params: slaveset, status
+ *  Optional params :
+ *
+ *  Return values:
+ *   0 Task succeeded (or no status)
+ *   1 Task failed
+ */
+static int
+slave_failed(slaveset_t *slaveset, int status){
+	if (status <= 0){
+		return(0);
+	}
+	if (slaveset->duration &&
+	    ((WIFSIGNALED(status) && (WTERMSIG(status) == slaveset->signum)) ||
+	     (WIFEXITED(status) && (WEXITSTATUS(status) == 128 + slaveset->signum)))){
+		return(0);
+	}
+	return(1);
+}
+
+/*
+ * static void
+ * slave_handle(slaveset_t *slaveset, slave_t *slave);
+ * ---------------------------------------------------
+ *  This function reads one message from 'slave' and advances its state
+ *  machine accordingly. Slaves that complete the current step decrement
+ *  'slaveset->pending'. Slaves whose connection fail are dropped.
+ *
+ *  Mandatory params: slaveset, slave
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_handle(slaveset_t *slaveset, slave_t *slave){
+	// Local variables
+	synexec_msg_t           net_msg;                // Synexec msg
+	char                    *data = NULL;           // Transfer buffer
+	struct timespec         now;                    // Time message was received
+	struct timespec         mono;                   // Time message was received (MT_SYNEXEC_CLOCK_MONO)
+	int                     i;                      // Temporary integer
+
+	// Read from this slave
+	i = comm_recv(slave->slave_fd, &net_msg, NULL, (void **)&data, NULL);
+	clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono);
+	if (i < 0){
+		i = slave->state;
+		slave_drop(slaveset, slave);
+		if (i == SLAVE_STATE_RUNNING){
+			slaveset_barrier(slaveset);
+		}
+		goto out;
+	}else
+	if (i == 0){
+		goto out;
+	}
+
+	switch (slave->state){
+	case SLAVE_STATE_HELLO:
+		// Process hello
+		if (net_msg.command != MT_SYNEXEC_MSG_REPLY){
+			slave_drop(slaveset, slave);
+			break;
+		}
+
+		// Start estimating the clock offset
+		slave->state = SLAVE_STATE_PROBE;
+		slave->probes = SYNEXEC_MASTER_COMM_SYNC_ROUNDS;
+		if (slave_probe(slave, 0) < 0){
+			slave_drop(slaveset, slave);
+		}
+		break;
+
+	case SLAVE_STATE_PROBE:
+		if (net_msg.command != MT_SYNEXEC_MSG_REPLY){
+			break;
+		}
+		if ((slave_sync(slave, &net_msg, data, &now) > 0) && (--slave->probes > 0)){
+			if (slave_probe(slave, 0) < 0){
+				slave_drop(slaveset, slave);
+			}
+			break;
+		}
+		if (verbose > 0){
+			printf("%s: Slave (%s:%hu) replied to probe (clock offset %" PRId64 " +/- %" PRId64 " ns).\n", __FUNCTION__,
+				inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port),
+				slave->clock_offset, slave->clock_error);
+			fflush(stdout);
+		}
+		if (!slave->joined){
+			// Slave is joining the set, unless it is already complete
+			if (slaveset->active >= slaveset->slaves){
+				slave_drop(slaveset, slave);
+				break;
+			}
+			slave->joined = 1;
+			slaveset->active++;
+		}
+		slave->state = SLAVE_STATE_IDLE;
+		slaveset->pending--;
+		break;
+
+	case SLAVE_STATE_CONF:
+		if (net_msg.command == MT_SYNEXEC_MSG_CONF_MISS){
+			// Slave does not have it cached (or could not fetch it), provide it
+			if (verbose > 1){
+				printf("%s: Slave (%s:%hu) does not have the configuration cached.\n", __FUNCTION__,
+					inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+				fflush(stdout);
+			}
+			slave_conf_source(slaveset, slave);
+			break;
+		}
+		slave->conf_time[1] = mono;
+		if (net_msg.command == MT_SYNEXEC_MSG_CONF_OK){
+			if (verbose > 0){
+				printf("%s: Configuration OK from slave (%s:%hu) after %" PRId64 " ns.\n", __FUNCTION__,
+					inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port),
+					ts_diff_nsec(&slave->conf_time[1], &slave->conf_time[0]));
+				fflush(stdout);
+			}
+			slave->state = SLAVE_STATE_READY;
+			slaveset->pending--;
+			if (slaveset->tree){
+				slave_conf_children(slaveset, slave);
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_CONF_NO){
+			fprintf(stderr, "%s: Slave (%s:%hu) refused configuration file.\n", __FUNCTION__, inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			slave->state = SLAVE_STATE_IDLE;
+			slaveset->pending--;
+			slaveset->failed++;
+			if (slaveset->tree){
+				slave_conf_children(slaveset, slave);
+			}
+		}
+		break;
+
+	case SLAVE_STATE_RUNNING:
+		// Anything from the slave shows it is alive
+		slave->beat_time = mono;
+
+		if ((net_msg.command == MT_SYNEXEC_MSG_RUNNING) &&
+		    (net_msg.datalen == sizeof(synexec_running_t))){
+			synexec_running_t running;
+			int64_t           cpu;
+
+			// Unmarshal progress
+			memcpy(&running, data, sizeof(running));
+			cpu = (running.utime.tv_sec + running.stime.tv_sec) * 1000000000 +
+			      running.utime.tv_nsec + running.stime.tv_nsec;
+
+			// A worker that stops using the CPU may be hung
+			if (cpu > slave->beat_cpu){
+				slave->beat_idle = 0;
+			}else
+			if (++slave->beat_idle == SYNEXEC_MASTER_COMM_BEAT_IDLE){
+				fprintf(stderr, "%s: Slave (%s:%hu) used no CPU in the last %d heartbeats, it may be hung.\n", __FUNCTION__,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port), slave->beat_idle);
+				fflush(stderr);
+			}
+			slave->beat_elapsed = running.elapsed;
+			slave->beat_cpu = cpu;
+			slave->beat_rss = running.rss;
+			if (verbose > 1){
+				printf("%s: Slave (%s:%hu) running for %" PRId64 " ns, cpu %" PRId64 " ns, rss %" PRId64 " KiB.\n", __FUNCTION__,
+				       inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port),
+				       slave->beat_elapsed, slave->beat_cpu, slave->beat_rss);
+				fflush(stdout);
+			}
+		}else
+		if ((net_msg.command == MT_SYNEXEC_MSG_EXEC_OK) &&
+		    (net_msg.datalen == sizeof(synexec_exec_ok_t))){
+			synexec_exec_ok_t exec_rep;
+
+			// The slave run time limit counts from now
+			slave->run_time = mono;
+
+			// Unmarshal start times
+			memcpy(&exec_rep, data, sizeof(exec_rep));
+			net_to_ts(&exec_rep.intended, &slave->exec_time[0]);
+			net_to_ts(&exec_rep.actual, &slave->exec_time[1]);
+			net_to_ts(&exec_rep.exec, &slave->exec_time[2]);
+
+			// Translate to the master clock
+			if (slave->exec_time[0].tv_sec || slave->exec_time[0].tv_nsec){
+				ts_add_nsec(&slave->exec_time[0], -slave->clock_offset);
+			}
+			ts_add_nsec(&slave->exec_time[1], -slave->clock_offset);
+			ts_add_nsec(&slave->exec_time[2], -slave->clock_offset);
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_EXEC_NO){
+			fprintf(stderr, "%s: Slave (%s:%hu) refused to execute.\n", __FUNCTION__,
+			        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			fflush(stderr);
+			slave->state = SLAVE_STATE_IDLE;
+			slaveset->pending--;
+			slaveset->failed++;
+			if (slaveset->failfast && !slaveset->abort){
+				slaveset->abort = 1;
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_FINISHD){
+			synexec_finishd_t finishd;
+
+			if (net_msg.datalen != sizeof(finishd)){
+				fprintf(stderr, "%s: Wrong datalen for FINISHD (slave %s:%hu).\n", __FUNCTION__,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+				fflush(stderr);
+				slave_drop(slaveset, slave);
+				break;
+			}
+
+			// Terminate the output of the task, so nothing else is appended to it
+			if (slave->out_partial){
+				printf("\n");
+				slave->out_partial = 0;
+			}
+
+			// Unmarshal data
+			memcpy(&finishd, data, sizeof(finishd));
+			net_to_ts(&finishd.time[0], &slave->slave_time[0]);
+			net_to_ts(&finishd.time[1], &slave->slave_time[1]);
+			slave->elapsed = finishd.elapsed;
+			slave->status = finishd.status;
+			net_to_ru(&finishd.rusage, &slave->rusage);
+
+			// Translate to the master clock
+			ts_add_nsec(&slave->slave_time[0], -slave->clock_offset);
+			ts_add_nsec(&slave->slave_time[1], -slave->clock_offset);
+
+			printf("%s: Slave (%s:%hu) completed", __FUNCTION__,
+			        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			if (slave->status < 0){
+				printf("\n");
+			}else
+			if (WIFSIGNALED(slave->status)){
+				printf(" (killed by signal %d)\n", WTERMSIG(slave->status));
+			}else{
+				printf(" (exit status %d)\n", WEXITSTATUS(slave->status));
+			}
+			fflush(stdout);
+			slave->state = SLAVE_STATE_DONE;
+			slaveset->pending--;
+
+			// A failed task brings the session down, if so requested
+			if (slaveset->failfast && !slaveset->abort && slave_failed(slaveset, slave->status)){
+				fprintf(stderr, "%s: Slave (%s:%hu) failed, aborting the session.\n", __FUNCTION__,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+				fflush(stderr);
+				slaveset->failed++;
+				slaveset->abort = 1;
+			}
+
+			// The others no longer wait for it at barriers
+			slaveset_barrier(slaveset);
+		}else
+		if ((net_msg.command == MT_SYNEXEC_MSG_STOPPED) &&
+		    (net_msg.datalen == sizeof(synexec_signal_t))){
+			synexec_signal_t stopped;
+
+			// Note a failed delivery
+			memcpy(&stopped, data, sizeof(stopped));
+			if (stopped.signum < 0){
+				slave->stop_errno = -stopped.signum;
+				fprintf(stderr, "%s: Slave (%s:%hu) failed to deliver signal %d: %s.\n", __FUNCTION__,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port),
+				        slaveset->signum, strerror(slave->stop_errno));
+				fflush(stderr);
+				break;
+			}
+
+			// Unmarshal the delivery time and translate it to the master clock
+			net_to_ts(&stopped.deliver, &slave->stop_time);
+			ts_add_nsec(&slave->stop_time, -slave->clock_offset);
+			if (verbose > 0){
+				printf("%s: Slave (%s:%hu) delivered signal %d.\n", __FUNCTION__,
+				       inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port), stopped.signum);
+				fflush(stdout);
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_OUTPUT){
+			slave_output(slaveset, slave, data, net_msg.datalen);
+		}else
+		if ((net_msg.command == MT_SYNEXEC_MSG_INSTANCE) &&
+		    (net_msg.datalen == sizeof(synexec_instance_t))){
+			synexec_instance_t inst;
+			slave_inst_t       *ptr;
+
+			// Keep the results in order of instance number
+			memcpy(&inst, data, sizeof(inst));
+			if ((inst.index < 0) || (inst.index != slave->inst_count)){
+				fprintf(stderr, "%s: Unexpected instance %d from slave (%s:%hu).\n", __FUNCTION__, inst.index,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+				fflush(stderr);
+				break;
+			}
+			if ((ptr = realloc(slave->inst, (slave->inst_count+1) * sizeof(*ptr))) == NULL){
+				perror("realloc");
+				fprintf(stderr, "%s: Error recording instance %d.\n", __FUNCTION__, inst.index);
+				break;
+			}
+			slave->inst = ptr;
+			ptr = &slave->inst[slave->inst_count++];
+
+			// Unmarshal and translate to the master clock
+			ptr->cpu = inst.cpu;
+			net_to_ts(&inst.time[0], &ptr->time[0]);
+			net_to_ts(&inst.time[1], &ptr->time[1]);
+			ts_add_nsec(&ptr->time[0], -slave->clock_offset);
+			ts_add_nsec(&ptr->time[1], -slave->clock_offset);
+			ptr->elapsed = inst.elapsed;
+			ptr->status = inst.status;
+			net_to_ru(&inst.rusage, &ptr->rusage);
+		}else
+		if ((net_msg.command == MT_SYNEXEC_MSG_BARRIER) &&
+		    (net_msg.datalen == sizeof(synexec_barrier_t))){
+			synexec_barrier_t barrier;
+
+			memcpy(&barrier, data, sizeof(barrier));
+			barrier.name[sizeof(barrier.name)-1] = 0;
+			strcpy(slave->barrier, barrier.name);
+			if (verbose > 0){
+				printf("%s: Slave (%s:%hu) reached barrier '%s'.\n", __FUNCTION__,
+				       inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port), slave->barrier);
+				fflush(stdout);
+			}
+			slaveset_barrier(slaveset);
+		}else
+		if ((net_msg.command == MT_SYNEXEC_MSG_BARRIER_OK) &&
+		    (net_msg.datalen == sizeof(synexec_barrier_t))){
+			synexec_barrier_t barrier;
+			struct timespec   released;
+
+			// Translate the release time to the master clock
+			memcpy(&barrier, data, sizeof(barrier));
+			net_to_ts(&barrier.release, &released);
+			ts_add_nsec(&released, -slave->clock_offset);
+			if (!slaveset->barrier_span[0].tv_sec || (ts_diff_nsec(&released, &slaveset->barrier_span[0]) < 0)){
+				slaveset->barrier_span[0] = released;
+			}
+			if (!slaveset->barrier_span[1].tv_sec || (ts_diff_nsec(&released, &slaveset->barrier_span[1]) > 0)){
+				slaveset->barrier_span[1] = released;
+			}
+
+			// Report the spread once all slaves released it
+			if (--slaveset->barrier_acks == 0){
+				printf("Barrier '%s' released, spread across slaves %" PRId64 " ns", slaveset->barrier,
+				       ts_diff_nsec(&slaveset->barrier_span[1], &slaveset->barrier_span[0]));
+				if (slaveset->barrier_time.tv_sec){
+					printf(", latest %+" PRId64 " ns from the deadline",
+					       ts_diff_nsec(&slaveset->barrier_span[1], &slaveset->barrier_time));
+				}
+				printf(".\n");
+				fflush(stdout);
+				memset(slaveset->barrier_span, 0, sizeof(slaveset->barrier_span));
+			}
+		}
+		break;
 
-	// Process the reply
-	if (comm_recv(sock, &net_msg, NULL, NULL, NULL) <= 0){
-		goto err;
-	}
-	if (net_msg.command != MT_SYNEXEC_MSG_REPLY){
-		goto err;
+	default:
+		// Output tails of slaves given up on may still arrive
+		if ((slave->state == SLAVE_STATE_LATE) && (net_msg.command == MT_SYNEXEC_MSG_OUTPUT)){
+			slave_output(slaveset, slave, data, net_msg.datalen);
+			break;
+		}
+		if (verbose > 0){
+			printf("%s: Ignoring unexpected message %hhd from slave (%s:%hu).\n", __FUNCTION__, net_msg.command,
+				inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			fflush(stdout);
+		}
+		break;
 	}
 
 out:
-	// Return
-	return(err);
-
-err:
-	err = -1;
-	goto out;
+	// Release message data
+	if (data){
+		comm_free(data);
+	}
 }
 
-
 /*
  * int
- * slave_probe(slave_t *slave_aux);
- * --------------------------------
- *  Probe the TCP fd for 'slave_aux'.
+ * slaveset_wait(slaveset_t *slaveset, int listen_fd, int timeout);
+ * ----------------------------------------------------------------
+ *  This function implements the master event loop. It waits on the epoll
+ *  instance of 'slaveset' and dispatches each event to the slave it belongs
+ *  to, so the cost per event does not depend on the size of the set. It
+ *  returns when 'slaveset->pending' drops to zero or after 'timeout' msecs.
+ *  If 'listen_fd' is specified, new connections on it are accepted into the
+ *  set (it must have been added to the epoll instance with a NULL pointer).
+ *  An abort of the session (see abort_slaves()) makes it return an error
+ *  right away, be it requested by a signal or by a failed task.
  *
- *  Mandatory params: slave_aux
- *  Optional params :
+ *  Mandatory params: slaveset
+ *  Optional params : listen_fd, timeout (-1 waits forever)
  *
  *  Return values:
  *   -1 Error
- *    0 Success
+ *    0 Timeout
+ *    1 No more slaves pending
  */
 int
-slave_probe(slave_t *slave_aux){
+slaveset_wait(slaveset_t *slaveset, int listen_fd, int timeout){
 	// Local variables
+	struct epoll_event      events[SYNEXEC_MASTER_COMM_EVENTS];
+	struct timespec         now;                    // Current time
+	struct timespec         end;                    // Time to give up
+	int                     left = -1;              // Time left (msecs)
+	slave_t                 *slave;                 // Temporary slave
+
+	int                     i, n;                   // Temporary integers
 	int                     err = 0;                // Return code
 
-	if (verbose > 0){
-		printf("%s: Probing slave (%s:%hu).\n", __FUNCTION__,
-			inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
+	// Work out when to give up
+	if (timeout >= 0){
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		end.tv_sec  += timeout / 1000;
+		end.tv_nsec += (timeout % 1000) * 1000000;
+		if (end.tv_nsec >= 1000000000){
+			end.tv_sec++;
+			end.tv_nsec -= 1000000000;
+		}
 	}
 
-	// Probe the slave
-	if (slave_fd_probe(slave_aux->slave_fd) < 0){
-		if (verbose > 0){
-			printf("%s: Error probing slave (%s:%hu).\n", __FUNCTION__,
-				inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
+	// Loop until all slaves completed the current step
+	while (slaveset->pending > 0){
+		if (aborting && !slaveset->abort){
+			slaveset->abort = 1;
 		}
-		goto err;
-	} else {
-		if (verbose > 0){
-			printf("%s: Slave (%s:%hu) replied to probe.\n", __FUNCTION__,
-				inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
+		if (slaveset->abort == 1){
+			goto err;
+		}
+		if (timeout >= 0){
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			left = ((end.tv_sec - now.tv_sec) * 1000) + ((end.tv_nsec - now.tv_nsec) / 1000000);
+			if (left <= 0){
+				goto out;
+			}
+		}
+
+		n = epoll_wait(slaveset->epfd, events, SYNEXEC_MASTER_COMM_EVENTS, left);
+		if (n < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			perror("epoll_wait");
+			fprintf(stderr, "%s: Error waiting for slave events.\n", __FUNCTION__);
+			goto err;
+		}
+
+		// Dispatch events
+		for (i=0; i<n; i++){
+			slave = events[i].data.ptr;
+			if (!slave){
+				if ((listen_fd >= 0) && (comm_tcp_accept(listen_fd, slaveset) < 0)){
+					goto err;
+				}
+				continue;
+			}
+			if (slave->state == SLAVE_STATE_DEAD){
+				continue;
+			}
+			if ((events[i].events & EPOLLOUT) && slave->tx_len){
+				if (slave_tx(slaveset, slave) < 0){
+					slave_drop(slaveset, slave);
+					continue;
+				}
+			}
+			if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+				// Handle every message that came in with this one, they do not raise events
+				do {
+					slave_handle(slaveset, slave);
+				} while ((slave->state != SLAVE_STATE_DEAD) && comm_pending(slave->slave_fd));
+			}
 		}
+
+		// Remove slaves that died in this batch
+		slaveset_purge(slaveset);
 	}
+	err = 1;
 
 out:
 	// Return
@@ -310,8 +1330,8 @@ wait_slaves(slaveset_t *slaveset){
 
 	int                     net_tcpfd = -1;         // TCP socket
 	struct sockaddr_in      net_tcpaddr;            // TCP address
-
-	struct timeval          fds_timeout;            // select timeout
+	struct epoll_event      event;                  // epoll registration
+	slave_t                 *slave;                 // Temporary slave
 
 	int                     i;                      // Temporary integer
 	int                     err = 0;                // Return code
@@ -338,7 +1358,7 @@ wait_slaves(slaveset_t *slaveset){
 	}
 
 	// Setup TCP socket to accept new connections
-	if ((net_tcpfd = socket(AF_INET, SOCK_STREAM, 0)) < 0){
+	if ((net_tcpfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0){
 		perror("socket");
 		fprintf(stderr, "%s: Error creating TCP socket.\n", __FUNCTION__);
 		goto err;
@@ -358,33 +1378,58 @@ wait_slaves(slaveset_t *slaveset){
 		fprintf(stderr, "%s: Error binding TCP socket.\n", __FUNCTION__);
 		goto err;
 	}
-	listen(net_tcpfd, 128);
+	listen(net_tcpfd, SOMAXCONN);
+
+	// Drop slaves given up on in a previous session, they may still be running it
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state == SLAVE_STATE_LATE){
+			slave_drop(slaveset, slave);
+		}
+		slave = slave->next;
+	}
+	slaveset_purge(slaveset);
 
-	// Send UDP broadcast query every second until I have my slaves up
 	do {
-		// Send the probe broadcast
-		if (verbose > 0){
-			printf("%s: Sending UDP Probe broadcast...\n", __FUNCTION__);
-			fflush(stdout);
+		// Accept new connections from the event loop
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		if (epoll_ctl(slaveset->epfd, EPOLL_CTL_ADD, net_tcpfd, &event) < 0){
+			perror("epoll_ctl");
+			fprintf(stderr, "%s: Error adding TCP socket to epoll set.\n", __FUNCTION__);
+			goto err;
 		}
-		comm_udp_broadcast(net_udpfd);
 
-		// Set time to wait for replies
-		fds_timeout.tv_sec = SYNEXEC_MASTER_COMM_PROBE_WAIT;
-		fds_timeout.tv_usec = 0;
-		do {
-			i = comm_tcp_accept(net_tcpfd, &fds_timeout, slaveset);
-			slaveset->active += i;
-		} while ((i > 0) && (slaveset->active < slaveset->slaves));
-		if (verbose > 1){
-			printf("%s: Done waiting for UDP replies.\n", __FUNCTION__);
-			fflush(stdout);
+		// Send UDP broadcast query every second until I have my slaves up
+		while (slaveset->active < slaveset->slaves){
+			// Send the probe broadcast
+			if (verbose > 0){
+				printf("%s: Sending UDP Probe broadcast...\n", __FUNCTION__);
+				fflush(stdout);
+			}
+			comm_udp_broadcast(net_udpfd);
+
+			// Wait for replies
+			slaveset->pending = slaveset->slaves - slaveset->active;
+			if (slaveset_wait(slaveset, net_tcpfd, SYNEXEC_MASTER_COMM_PROBE_WAIT * 1000) < 0){
+				goto err;
+			}
+			if (verbose > 1){
+				printf("%s: Done waiting for UDP replies.\n", __FUNCTION__);
+				fflush(stdout);
+			}
 		}
-		if (slaveset_probe(slaveset) < 0){
+
+		// Stop accepting connections
+		if (epoll_ctl(slaveset->epfd, EPOLL_CTL_DEL, net_tcpfd, &event) < 0){
+			perror("epoll_ctl");
+			fprintf(stderr, "%s: Error removing TCP socket from epoll set.\n", __FUNCTION__);
 			goto err;
 		}
-	}
-	while (slaveset->slaves != slaveset->active);
+
+		// Validate the set (and refresh the clock offsets)
+	} while (slaveset_probe(slaveset) < slaveset->slaves);
 
 out:
 	// Free resources
@@ -404,48 +1449,128 @@ err:
 }
 
 /*
- * static int
- * config_slave(slave_t *slave, char *conf_ptr, off_t conf_len);
- * -------------------------------------------------------------
- *  This function sends the session configuration file to 'slave' and confirms
- *  that he is happy with the contents.
+ * int
+ * config_slaves(slaveset_t *slaveset, int conf_fd, char *conf_ptr,
+ *               off_t conf_len);
+ * ----------------------------------------------------------------
+ *  This function sends the session configuration file to all the slaves and
+ *  confirms that they are happy with the contents. Only the SHA-256 of the
+ *  file is sent at first. Slaves that have it cached accept it right away and
+ *  the others reply with a MT_SYNEXEC_MSG_CONF_MISS, in which case the file is
+ *  sent (see slave_send_conf()). Transfers to all slaves happen concurrently in
+ *  the event loop (so a slow slave does not delay the others) and the replies
+ *  are collected as they arrive. The time each slave took to acknowledge the
+ *  configuration is recorded in 'conf_time'.
+ *  If 'slaveset->fanout' is set, the slaves are laid out in a tree of that
+ *  arity and slaves that miss the file fetch it from their parent once it has
+ *  it, so the master only sends it to the top of the tree.
  *
- *  Mandatory params: slave, conf_ptr
+ *  Mandatory params: slaveset, conf_fd, conf_ptr
  *  Optional params :
  *
  *  Return values:
  *   -1 Error
  *    0 Success
  */
-static int
-config_slave(slave_t *slave, char *conf_ptr, off_t conf_len){
+int
+config_slaves(slaveset_t *slaveset, int conf_fd, char *conf_ptr, off_t conf_len){
 	// Local variables
-	synexec_msg_t		net_msg;		// Synexec msg
+	slave_t                 *slave;                 // Temporary slave
+	slave_t                 *slowest = NULL;        // Slowest slave to acknowledge
+	struct timespec         start;                  // Time distribution started (MT_SYNEXEC_CLOCK_MONO)
+	synexec_hash_t          ctx;                    // Hash context
+	char                    hex[SYNEXEC_HASH_HEXLEN];// Hash in hex
+	int                     misses[3] = {0};        // Slaves by configuration source
 	int                     err = 0;                // Return code
 
-	// Send configuration to slave
-	if (comm_send(slave->slave_fd, MT_SYNEXEC_MSG_CONF, NULL, conf_ptr, conf_len) < 0){
-		goto err;
-	}
+	// Describe the configuration
+	slaveset->conf_fd = conf_fd;
+	slaveset->conf_ptr = conf_ptr;
+	slaveset->conf_len = conf_len;
+	slaveset->conf_stream.length = conf_len;
+	slaveset->conf.length = conf_len;
+	hash_init(&ctx);
+	hash_update(&ctx, conf_ptr, conf_len);
+	hash_final(&ctx, slaveset->conf.hash);
 	if (verbose > 0){
-		printf("%s: Configuration sent to slave (%s:%hu).\n", __FUNCTION__, inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+		hash_hex(slaveset->conf.hash, hex);
+		printf("%s: Configuration hash is %s.\n", __FUNCTION__, hex);
 		fflush(stdout);
 	}
 
-	// Await reply
-	if (comm_recv(slave->slave_fd, &net_msg, NULL, NULL, NULL) < 0){
+	// Lay the slaves out in a tree, if requested
+	if (slaveset->fanout > 0){
+		if ((slaveset->tree = calloc(slaveset->active, sizeof(slave_t *))) == NULL){
+			perror("calloc");
+			fprintf(stderr, "%s: Error allocating distribution tree.\n", __FUNCTION__);
+			goto err;
+		}
+		slaveset->tree_len = 0;
+		slave = slaveset->slave;
+		while(slave && (slaveset->tree_len < slaveset->active)){
+			slave->tree_index = slaveset->tree_len;
+			slaveset->tree[slaveset->tree_len++] = slave;
+			slave = slave->next;
+		}
+	}
+
+	// Offer the configuration to all slaves
+	slaveset->pending = 0;
+	slaveset->failed = 0;
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &start);
+	slave = slaveset->slave;
+	while(slave){
+		clock_gettime(MT_SYNEXEC_CLOCK_MONO, &slave->conf_time[0]);
+		memset(&slave->conf_time[1], 0, sizeof(slave->conf_time[1]));
+		slave->conf_miss = 0;
+		slave->conf_wait = 0;
+		if (slave_send(slaveset, slave, MT_SYNEXEC_MSG_CONF_HASH, &slaveset->conf, sizeof(slaveset->conf), -1, 0) < 0){
+			fprintf(stderr, "%s: Error sending configuration to slave (%s:%hu).\n", __FUNCTION__, inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			slave_drop(slaveset, slave);
+			goto err;
+		}
+		if (verbose > 1){
+			printf("%s: Offering configuration to slave (%s:%hu).\n", __FUNCTION__, inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			fflush(stdout);
+		}
+		slave->state = SLAVE_STATE_CONF;
+		slaveset->pending++;
+		slave = slave->next;
+	}
+
+	// Await replies (and complete the transfers)
+	if (slaveset_wait(slaveset, -1, -1) < 0){
 		goto err;
 	}
-	if (net_msg.command != MT_SYNEXEC_MSG_CONF_OK){
-		fprintf(stderr, "%s: Slave (%s:%hu) refused configuration file.\n", __FUNCTION__, inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+	if (slaveset->failed){
 		goto err;
 	}
-	if (verbose > 0){
-		printf("%s: Configuration OK from slave (%s:%hu).\n", __FUNCTION__, inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+
+	// Report acknowledgement times
+	slave = slaveset->slave;
+	while(slave){
+		if (!slowest || (ts_diff_nsec(&slave->conf_time[1], &slowest->conf_time[1]) > 0)){
+			slowest = slave;
+		}
+		misses[slave->conf_miss]++;
+		slave = slave->next;
+	}
+	if (slowest){
+		printf("Configuration (%lld bytes, sent to %d, fetched from peers by %d, cached on %d) acknowledged by %d slaves in %" PRId64 " ns (slowest %s:%hu).\n",
+		       (long long)conf_len, misses[1], misses[2], misses[0], slaveset->active,
+		       ts_diff_nsec(&slowest->conf_time[1], &start),
+		       inet_ntoa(slowest->slave_addr.sin_addr), ntohs(slowest->slave_addr.sin_port));
 		fflush(stdout);
 	}
 
 out:
+	// Free the distribution tree
+	if (slaveset->tree){
+		free(slaveset->tree);
+		slaveset->tree = NULL;
+		slaveset->tree_len = 0;
+	}
+
 	// Return
 	return(err);
 
@@ -456,49 +1581,323 @@ err:
 
 /*
  * int
- * config_slaves(slaveset_t *slaveset, char *conf_ptr, off_t conf_len);
- * --------------------------------------------------------------------
- *  This function sends the session configuration file to all the slaves and
- *  confirms that they are happy with the contents.
+ * execute_slaves(slaveset_t *slaveset, uint32_t start_delay);
+ * -----------------------------------------------------------
+ *  This function sends the execution command to all the slaves, without
+ *  waiting for acknowledgement. If 'start_delay' is zero, slaves start the
+ *  execution immediately. Otherwise, all slaves are given the same deadline
+ *  ('start_delay' msecs from now) and start together once it is reached.
+ *  The deadline is translated to each slave's clock using the offset
+ *  estimated by slave_probe(). Slaves report the intended and actual start
+ *  times in their EXEC_OK, which is collected by join_slaves(). Slaves are
+ *  also asked to send heartbeats every 'slaveset->heartbeat' msecs. If
+ *  'slaveset->duration' is set, slaves are also told to deliver
+ *  'slaveset->signum' to their tasks once it elapsed from the (common) start,
+ *  so every task runs for the same time.
  *
- *  Mandatory params: slaveset, conf_ptr
- *  Optional params :
+ *  Mandatory params: slaveset
+ *  Optional params : start_delay
  *
  *  Return values:
  *   -1 Error
  *    0 Success
  */
 int
-config_slaves(slaveset_t *slaveset, char *conf_ptr, off_t conf_len){
+execute_slaves(slaveset_t *slaveset, uint32_t start_delay){
 	// Local variables
-	slave_t                 *slave;                 // Temporary slave
-	int                     err = 0;                // Return code
+	slave_t                 *slave = NULL;          // Temporary slave
+	synexec_exec_t          exec_req;               // Execution request
+	synexec_signal_t        sig_req;                // Signal request
+	synexec_instances_t     inst_req;               // Instances request
+	struct timespec         start;                  // Start deadline
+	struct timespec         stop;                   // Signal deadline in slave clock
+	struct timespec         slave_start;            // Start deadline in slave clock
+	struct timespec         mono;                   // Current time (MT_SYNEXEC_CLOCK_MONO)
+	int                     err = 0;
+
+	// Compute the start deadline
+	memset(&exec_req, 0, sizeof(exec_req));
+	exec_req.heartbeat = slaveset->heartbeat;
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono);
+	ts_add_nsec(&mono, (int64_t)start_delay * 1000000);
+	slaveset->run_time = mono;
+	slaveset->start_delay = start_delay;
+	if (start_delay){
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &start);
+		ts_add_nsec(&start, (int64_t)start_delay * 1000000);
+		if (verbose > 0){
+			printf("%s: Scheduling start at %ld.%09ld.\n", __FUNCTION__, (long)start.tv_sec, start.tv_nsec);
+			fflush(stdout);
+		}
+	}
+
+	// Compute the signal deadline, counting from the start
+	memset(&slaveset->stop_time, 0, sizeof(slaveset->stop_time));
+	memset(&sig_req, 0, sizeof(sig_req));
+	if (slaveset->duration){
+		if (start_delay){
+			slaveset->stop_time = start;
+		}else{
+			clock_gettime(MT_SYNEXEC_CLOCK_WALL, &slaveset->stop_time);
+		}
+		ts_add_nsec(&slaveset->stop_time, (int64_t)slaveset->duration * 1000000);
+		sig_req.signum = slaveset->signum;
+	}
+
+	// Ask for several instances per slave, if so configured
+	inst_req.count = slaveset->instances;
+	inst_req.pin = slaveset->pin;
 
 	// Iterate through slaves
+	slaveset->pending = 0;
+	slaveset->failed = 0;
 	slave = slaveset->slave;
 	while(slave){
-		if (config_slave(slave, conf_ptr, conf_len) != 0){
+		// Leave out slaves given up on in a previous iteration
+		if (slave->state == SLAVE_STATE_LATE){
+			slave = slave->next;
+			continue;
+		}
+
+		if (((inst_req.count != 1) || inst_req.pin) &&
+		    (batch_send(slave, MT_SYNEXEC_MSG_INSTANCES, &inst_req, sizeof(inst_req)) < 0)){
+			goto err;
+		}
+
+		// Translate the deadline to the slave clock
+		if (start_delay){
+			slave_start = start;
+			ts_add_nsec(&slave_start, slave->clock_offset);
+			ts_to_net(&slave_start, &exec_req.start);
+		}
+		if (batch_send(slave, MT_SYNEXEC_MSG_EXEC_AT, &exec_req, sizeof(exec_req)) < 0){
 			goto err;
 		}
+		if (slaveset->duration){
+			stop = slaveset->stop_time;
+			ts_add_nsec(&stop, slave->clock_offset);
+			ts_to_net(&stop, &sig_req.deliver);
+			if (batch_send(slave, MT_SYNEXEC_MSG_SIGNAL, &sig_req, sizeof(sig_req)) < 0){
+				goto err;
+			}
+		}
+		slave->state = SLAVE_STATE_RUNNING;
+		slave->run_time = mono;
+		slave->straggler = 0;
+		slave->beat_time = mono;
+		slave->beat_elapsed = slave->beat_cpu = slave->beat_rss = 0;
+		slave->beat_idle = 0;
+		slave->barrier[0] = 0;
+		memset(&slave->stop_time, 0, sizeof(slave->stop_time));
+		slave->stop_errno = 0;
+		slave->status = -1;
+		slave->elapsed = 0;
+		slave->inst_count = 0;
+		memset(slave->slave_time, 0, sizeof(slave->slave_time));
+		memset(slave->exec_time, 0, sizeof(slave->exec_time));
+		slaveset->pending++;
 		slave = slave->next;
 	}
 
+	// Send the requests, all at once
+	if (slaveset_flush(slaveset) > 0){
+		goto err;
+	}
+
 out:
 	// Return
 	return(err);
 
 err:
 	err = -1;
+	(void)slaveset_flush(slaveset);
 	goto out;
 }
 
+/*
+ * static void
+ * slaveset_progress(slaveset_t *slaveset);
+ * ----------------------------------------
+ *  This function is called by join_slaves() at every heartbeat interval. It
+ *  drops the running slaves that have not been heard from in
+ *  SYNEXEC_MASTER_COMM_BEAT_MISS intervals, which are deemed dead, and prints
+ *  one line summarising the progress of the set from the last heartbeats.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slaveset_progress(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	struct timespec         now;                    // Current time (MT_SYNEXEC_CLOCK_MONO)
+	int64_t                 silent;                 // Time since a slave was heard from (nsecs)
+	int64_t                 elapsed = 0;            // Longest run time
+	int64_t                 cpu = 0;                // Total CPU time
+	int64_t                 rss = 0;                // Largest resident set size
+	int                     done = 0;               // Slaves finished
+	int                     running = 0;            // Slaves running
+	int                     idle = 0;               // Slaves running without CPU progress
+
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state == SLAVE_STATE_DONE){
+			done++;
+		}else
+		if (slave->state == SLAVE_STATE_RUNNING){
+			// Drop slaves that went silent
+			silent = ts_diff_nsec(&now, &slave->beat_time);
+			if (silent > (int64_t)slaveset->heartbeat * 1000000 * SYNEXEC_MASTER_COMM_BEAT_MISS){
+				fprintf(stderr, "%s: Slave (%s:%hu) not heard from in %" PRId64 " ms, deeming it dead.\n", __FUNCTION__,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port), silent / 1000000);
+				fflush(stderr);
+				slave_drop(slaveset, slave);
+			}else{
+				running++;
+				if (slave->beat_idle >= SYNEXEC_MASTER_COMM_BEAT_IDLE){
+					idle++;
+				}
+				elapsed = (slave->beat_elapsed > elapsed)?slave->beat_elapsed:elapsed;
+				rss = (slave->beat_rss > rss)?slave->beat_rss:rss;
+				cpu += slave->beat_cpu;
+			}
+		}
+		slave = slave->next;
+	}
+	slaveset_purge(slaveset);
+
+	printf("Progress: %d of %d slaves finished, %d running (%d idle), elapsed %" PRId64 " ms, cpu %" PRId64 " ms, max rss %" PRId64 " KiB.\n",
+	       done, slaveset->active, running, idle, elapsed / 1000000, cpu / 1000000, rss);
+	fflush(stdout);
+}
+
+/*
+ * static void
+ * slave_late(slaveset_t *slaveset, slave_t *slave, char *reason);
+ * ---------------------------------------------------------------
+ *  This function gives up waiting for 'slave' to finish. It remains in the
+ *  set as SLAVE_STATE_LATE, so it is listed in the final report. Unless the
+ *  set accepts partial results, the execution step is accounted as failed.
+ *  The slave is asked for the last output of its task (MT_SYNEXEC_MSG_TAIL),
+ *  which is printed if it arrives while the master still waits. The request
+ *  is queued without blocking (see slave_send()), and skipped if another
+ *  message is still being sent to the slave.
+ *
+ *  Mandatory params: slaveset, slave, reason
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_late(slaveset_t *slaveset, slave_t *slave, char *reason){
+	fprintf(stderr, "%s: Giving up on slave (%s:%hu): %s.\n", __FUNCTION__,
+	        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port), reason);
+	fflush(stderr);
+	slave->state = SLAVE_STATE_LATE;
+	slaveset->pending--;
+	if (!slaveset->partial){
+		slaveset->failed++;
+	}
+
+	// Ask for the last output of its task, for slaves keeping it in memory, queued behind nothing
+	if (!slave->tx_len){
+		(void)slave_send(slaveset, slave, MT_SYNEXEC_MSG_TAIL, NULL, 0, -1, 0);
+	}
+}
+
+/*
+ * static void
+ * slaveset_deadlines(slaveset_t *slaveset);
+ * -----------------------------------------
+ *  This function is called periodically by join_slaves(). Running slaves past
+ *  the session or slave run time limits are given up on (see slave_late()).
+ *  Once at least half of the slaves finished, slaves that have been running
+ *  for longer than 'slaveset->straggler' times the median run time of the
+ *  finished ones are flagged as stragglers. If the set accepts partial
+ *  results, they are given up on as well.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slaveset_deadlines(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	struct timespec         now;                    // Current time (MT_SYNEXEC_CLOCK_MONO)
+	int64_t                 *elapsed = NULL;        // Run times of the finished slaves
+	int64_t                 limit = -1;             // Run time that flags a straggler (nsecs)
+	int                     done = 0;               // Slaves finished
+	char                    reason[64];             // Why a slave is given up on
+
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+
+	// Work out the straggler threshold from the median run time
+	if ((slaveset->straggler > 0) &&
+	    ((elapsed = malloc(slaveset->active * sizeof(*elapsed))) != NULL)){
+		slave = slaveset->slave;
+		while (slave){
+			if ((slave->state == SLAVE_STATE_DONE) && (done < slaveset->active)){
+				elapsed[done++] = slave->elapsed;
+			}
+			slave = slave->next;
+		}
+		if ((done > 0) && (done * 2 >= slaveset->active)){
+			qsort(elapsed, done, sizeof(*elapsed), int64_cmp);
+			limit = elapsed[done / 2] * slaveset->straggler;
+		}
+		free(elapsed);
+	}
+
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state != SLAVE_STATE_RUNNING){
+			slave = slave->next;
+			continue;
+		}
+		if (slaveset->timeout &&
+		    (ts_diff_nsec(&now, &slaveset->run_time) > (int64_t)slaveset->timeout * 1000000000)){
+			snprintf(reason, sizeof(reason), "session timed out after %u s", slaveset->timeout);
+			slave_late(slaveset, slave, reason);
+		}else
+		if (slaveset->slave_timeout &&
+		    (ts_diff_nsec(&now, &slave->run_time) > (int64_t)slaveset->slave_timeout * 1000000000)){
+			snprintf(reason, sizeof(reason), "timed out after %u s", slaveset->slave_timeout);
+			slave_late(slaveset, slave, reason);
+		}else
+		if ((limit >= 0) && !slave->straggler && (ts_diff_nsec(&now, &slave->run_time) > limit)){
+			slave->straggler = 1;
+			if (slaveset->partial){
+				snprintf(reason, sizeof(reason), "straggler, running for over %" PRId64 " ms", limit / 1000000);
+				slave_late(slaveset, slave, reason);
+			}else{
+				fprintf(stderr, "%s: Slave (%s:%hu) is a straggler, running for over %" PRId64 " ms.\n", __FUNCTION__,
+				        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port), limit / 1000000);
+				fflush(stderr);
+			}
+		}
+		slave = slave->next;
+	}
+}
+
 /*
  * int
- * execute_slaves(slaveset_t *slaveset);
- * -------------------------------------
- *  This function sends the execution command to all the slaves, without
- *  waiting for acknowledgement, causing them to start the execution
- *  immediately.
+ * join_slaves(slaveset_t *slaveset);
+ * ----------------------------------
+ *  This function keep track of the slaves that are executing, waiting for
+ *  them to finish their work and return the time values, the exit status and
+ *  the resource usage of their workers. All times are translated from the
+ *  slave clock to the master clock. If heartbeats were requested, progress is
+ *  printed at every interval and slaves that stop sending them are dropped.
+ *  Slaves running past the configured time limits, or stragglers when the set
+ *  accepts partial results, are given up on (see slaveset_deadlines()).
  *
  *  Mandatory params: slaveset
  *  Optional params :
@@ -508,18 +1907,45 @@ err:
  *    0 Success
  */
 int
-execute_slaves(slaveset_t *slaveset){
+join_slaves(slaveset_t *slaveset){
 	// Local variables
-	slave_t                 *slave = NULL;          // Temporary slave
-	int                     err = 0;
+	struct timespec         now;                    // Current time (MT_SYNEXEC_CLOCK_MONO)
+	struct timespec         beat;                   // Time progress is next due
+	int                     wait;                   // Time to wait for events (msecs)
+	int                     err = 0;                // Return code
 
-	// Iterate through slaves
-	slave = slaveset->slave;
-	while(slave){
-		if (comm_send(slave->slave_fd, MT_SYNEXEC_MSG_EXEC, NULL, NULL, 0) <= 0){
+	// Loop until all slaves have finished or were given up on
+	beat = slaveset->run_time;
+	ts_add_nsec(&beat, (int64_t)slaveset->heartbeat * 1000000);
+	while (slaveset->pending > 0){
+		// Wake up for the next heartbeat and to check deadlines
+		wait = -1;
+		if (slaveset->heartbeat){
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+			wait = (ts_diff_nsec(&beat, &now) + 999999) / 1000000;
+			wait = (wait < 0)?0:wait;
+		}
+		if ((slaveset->timeout || slaveset->slave_timeout || (slaveset->straggler > 0)) &&
+		    ((wait < 0) || (wait > SYNEXEC_MASTER_COMM_JOIN_TICK))){
+			wait = SYNEXEC_MASTER_COMM_JOIN_TICK;
+		}
+		if (slaveset_wait(slaveset, -1, wait) < 0){
 			goto err;
 		}
-		slave = slave->next;
+
+		// Report progress, if due
+		clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+		if (slaveset->heartbeat && (ts_diff_nsec(&now, &beat) >= 0)){
+			slaveset_progress(slaveset);
+			ts_add_nsec(&beat, (int64_t)slaveset->heartbeat * 1000000);
+		}
+		slaveset_deadlines(slaveset);
+
+		// Slaves dropped or given up on no longer hold barriers back
+		slaveset_barrier(slaveset);
+	}
+	if (slaveset->failed){
+		goto err;
 	}
 
 out:
@@ -533,10 +1959,16 @@ err:
 
 /*
  * int
- * join_slaves(slaveset_t *slaveset);
- * ----------------------------------
- *  This function keep track of the slaves that are executing, waiting for
- *  them to finish their work and return the time values.
+ * abort_slaves(slaveset_t *slaveset);
+ * -----------------------------------
+ *  This function tears the session down on all slaves. A MT_SYNEXEC_MSG_ABORT
+ *  is sent to every slave in the set, which kills the process group of its
+ *  task (if running), discards its armed worker and removes its configuration
+ *  file. Slaves still in the middle of receiving a message (such as a streamed
+ *  configuration) are dropped instead, as the abort cannot be sent before the
+ *  rest of it. Slaves that were running report a FINISHD once their task is
+ *  reaped, which is awaited for up to SYNEXEC_MASTER_COMM_ABORT_WAIT msecs.
+ *  Those that do not report in time are given up on (see SLAVE_STATE_LATE).
  *
  *  Mandatory params: slaveset
  *  Optional params :
@@ -546,88 +1978,81 @@ err:
  *    0 Success
  */
 int
-join_slaves(slaveset_t *slaveset){
+abort_slaves(slaveset_t *slaveset){
 	// Local variables
-	fd_set                  fds;                    // Select fd_set
-	int                     mfd;                    // Largest fd
-	synexec_msg_t           net_msg;                // Synexec msg
-	char                    *data;                  // Transfer buffer
-
-	int                     i;                      // Temporary integer
-	slave_t                 *slave = NULL;          // Temporary slave
+	slave_t                 *slave;                 // Temporary slave
+	struct timespec         start;                  // Time the abort was sent
+	struct timespec         now;                    // Current time
+	int32_t                 running = 0;            // Slaves that were running a task
+	int32_t                 aborted = 0;            // Slaves the abort was sent to
+	int32_t                 unconfirmed = 0;        // Running slaves that did not confirm the abort
 	int                     err = 0;                // Return code
 
-	// Loop until all slaves have finished
-	do {
-		// Set all slaves into the fd_set
-		FD_ZERO(&fds);
-		mfd = -1;
-		slave = slaveset->slave;
-		while(slave){
-			if (!memcmp(&(slave->slave_time[2]), &(slave->slave_time[1]), sizeof(slave->slave_time[2]))){
-				FD_SET(slave->slave_fd, &fds);
-				if (slave->slave_fd > mfd){
-					mfd = slave->slave_fd;
-				}
-			}
-			slave = slave->next;
-		}
-
-		if (mfd == -1){
-			// All slaves in set have completed
-			goto out;
+	// Drop slaves still receiving a message, their stream cannot be resynchronised
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &start);
+	slave = slaveset->slave;
+	while (slave){
+		if ((slave->state != SLAVE_STATE_DEAD) && slave->tx_len){
+			fprintf(stderr, "%s: Slave (%s:%hu) is still receiving a message, dropping it.\n", __FUNCTION__,
+			        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			fflush(stderr);
+			slave_drop(slaveset, slave);
 		}
+		slave = slave->next;
+	}
 
-		// Check which slaves have something to say
-		// TODO: This should timeout and then I need to probe the slaves
-		i = select(mfd+1, &fds, NULL, NULL, NULL);
-		if (i <= 0){
-			perror("select");
-			goto err;
-		}
-		slave = slaveset->slave;
-		while(slave){
-			if (FD_ISSET(slave->slave_fd, &fds)){
-				// Read from this slave
-				data = NULL;
-				i = comm_recv(slave->slave_fd, &net_msg, NULL, (void**)&data, NULL);
-				if (i < 0)
-					goto err;
-				if ((i > 0) && (net_msg.command == MT_SYNEXEC_MSG_FINISHD)){
-					struct {
-						int64_t tv_sec;
-						int64_t tv_usec;
-					} net_time[3];
-
-					if (net_msg.datalen != sizeof(net_time)){
-						fprintf(stderr, "%s: Wrong datalen for FINISHD (slave %s:%hu).\n", __FUNCTION__,
-						        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
-						fflush(stderr);
-						continue;
-					}
-
-					// Unmarshal data
-					memcpy(net_time, data, sizeof(net_time));
-					slave->slave_time[0].tv_sec = net_time[0].tv_sec; slave->slave_time[0].tv_usec = net_time[0].tv_usec;
-					slave->slave_time[1].tv_sec = net_time[1].tv_sec; slave->slave_time[1].tv_usec = net_time[1].tv_usec;
-					slave->slave_time[2].tv_sec = net_time[2].tv_sec; slave->slave_time[2].tv_usec = net_time[2].tv_usec;
-
-					printf("%s: Slave (%s:%hu) completed\n", __FUNCTION__,
-					        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
-					fflush(stdout);
-				}
+	// Stop releasing barriers and send the abort
+	slaveset->abort = 2;
+	slaveset->barrier[0] = 0;
+	slaveset->pending = 0;
+	slaveset->failed = 0;
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state != SLAVE_STATE_DEAD){
+			slave->barrier[0] = 0;
+			if ((slave->state == SLAVE_STATE_RUNNING) || (slave->state == SLAVE_STATE_LATE)){
+				slave->state = SLAVE_STATE_RUNNING;
+				slaveset->pending++;
+				running++;
+			}else{
+				slave->state = SLAVE_STATE_IDLE;
+			}
+			if (batch_send(slave, MT_SYNEXEC_MSG_ABORT, NULL, 0) < 0){
+				slave_drop(slaveset, slave);
+			}else{
+				aborted++;
 			}
-			slave = slave->next;
 		}
+		slave = slave->next;
+	}
+
+	aborted -= slaveset_flush(slaveset);
 
-	} while(1);
+	// Wait for the tasks to be killed
+	if (slaveset_wait(slaveset, -1, SYNEXEC_MASTER_COMM_ABORT_WAIT) < 0){
+		err = -1;
+	}
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state == SLAVE_STATE_RUNNING){
+			fprintf(stderr, "%s: Slave (%s:%hu) did not confirm the abort.\n", __FUNCTION__,
+			        inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+			fflush(stderr);
+			slave->state = SLAVE_STATE_LATE;
+			slaveset->pending--;
+			unconfirmed++;
+			err = -1;
+		}
+		slave = slave->next;
+	}
+	slaveset_purge(slaveset);
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
 
+	printf("Session aborted on %d slaves, %d of %d running tasks killed (%d unconfirmed) in %"PRId64" ns.\n",
+	       aborted, running-slaveset->failed-unconfirmed, running, unconfirmed, ts_diff_nsec(&now, &start));
+	fflush(stdout);
+	slaveset->abort = 0;
 
-out:
 	// Return
 	return(err);
-
-err:
-	err = -1;
-	goto out;
 }
@@ -27,28 +27,39 @@
 
 // Header files
 #include <inttypes.h>
+#include <sys/time.h>
+#include "synexec_common.h"
 #include "synexec_master_slaveset.h"
 
 // Global definitions
 #define SYNEXEC_MASTER_COMM_PROBE_WAIT  1       // Time to wait for probe replies (secs)
+#define SYNEXEC_MASTER_COMM_SYNC_ROUNDS 8       // Timestamped probes per slave for clock offset estimation
+#define SYNEXEC_MASTER_COMM_EVENTS      64      // Events handled per epoll_wait() call
+#define SYNEXEC_MASTER_COMM_BEAT_MISS   3       // Heartbeats missed before a running slave is deemed dead
+#define SYNEXEC_MASTER_COMM_BEAT_IDLE   3       // Heartbeats without CPU progress before a slave is deemed hung
+#define SYNEXEC_MASTER_COMM_JOIN_TICK   100     // Interval to check deadlines and stragglers (msecs)
+#define SYNEXEC_MASTER_COMM_ABORT_WAIT  1000    // Time to wait for aborted tasks to be reaped (msecs)
 
 // Related functions
 int
-wait_slaves(slaveset_t *slaveset);
+slaveset_wait(slaveset_t *slaveset, int listen_fd, int timeout);
 
 int
-slave_fd_probe(int sock);
+wait_slaves(slaveset_t *slaveset);
 
 int
-slave_probe(slave_t *slave_aux);
+slave_probe(slave_t *slave_aux, int batch);
 
 int
-config_slaves(slaveset_t *slaveset, char *conf_ptr, off_t conf_len);
+config_slaves(slaveset_t *slaveset, int conf_fd, char *conf_ptr, off_t conf_len);
 
 int
-execute_slaves(slaveset_t *slaveset);
+execute_slaves(slaveset_t *slaveset, uint32_t start_delay);
 
 int
 join_slaves(slaveset_t *slaveset);
 
+int
+abort_slaves(slaveset_t *slaveset);
+
 #endif /* SYNEXEC_MASTER_COMM_H */
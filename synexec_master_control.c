@@ -0,0 +1,278 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_master_control.c
+ * --------------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+// Header files
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "synexec_common.h"
+#include "synexec_master_control.h"
+
+// Global variables
+extern int              verbose;
+
+/*
+ * int
+ * control_listen(char *path);
+ * ---------------------------
+ *  This function creates the control socket of a persistent master at 'path',
+ *  replacing any stale socket left there.
+ *
+ *  Mandatory params: path
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *   >0 Listening socket
+ */
+int
+control_listen(char *path){
+	// Local variables
+	struct sockaddr_un      addr;                   // Control socket address
+	int                     control_fd = -1;        // Control socket
+
+	if (unix_addr(path, &addr) < 0){
+		goto err;
+	}
+	if ((control_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0){
+		perror("socket");
+		fprintf(stderr, "%s: Error creating control socket.\n", __FUNCTION__);
+		goto err;
+	}
+	(void)unlink(path);
+	if (bind(control_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		perror("bind");
+		fprintf(stderr, "%s: Error binding control socket to '%s'.\n", __FUNCTION__, path);
+		goto err;
+	}
+	if (listen(control_fd, SOMAXCONN) < 0){
+		perror("listen");
+		fprintf(stderr, "%s: Error listening on control socket '%s'.\n", __FUNCTION__, path);
+		goto err;
+	}
+
+out:
+	// Return
+	return(control_fd);
+
+err:
+	if (control_fd >= 0){
+		close(control_fd);
+		control_fd = -1;
+	}
+	goto out;
+}
+
+/*
+ * int
+ * control_accept(int control_fd, char *line, int len);
+ * ----------------------------------------------------
+ *  This function waits for a client on 'control_fd' and reads its session
+ *  submission, a single line of up to 'len'-1 bytes, into 'line'. The line
+ *  break is removed. Clients that do not send a complete line within
+ *  SYNEXEC_MASTER_CONTROL_TIMEO seconds are turned away.
+ *
+ *  Mandatory params: control_fd, line, len
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *   >0 Client socket
+ */
+int
+control_accept(int control_fd, char *line, int len){
+	// Local variables
+	struct timeval          timeo;                  // Receive timeout
+	int                     client_fd = -1;         // Client socket
+	int                     got = 0;                // Bytes read
+	int                     i;                      // Temporary integer
+
+	if ((client_fd = accept4(control_fd, NULL, NULL, SOCK_CLOEXEC)) < 0){
+		if (errno != EINTR){
+			perror("accept4");
+			fprintf(stderr, "%s: Error accepting control connection.\n", __FUNCTION__);
+		}
+		goto err;
+	}
+	timeo.tv_sec = SYNEXEC_MASTER_CONTROL_TIMEO;
+	timeo.tv_usec = 0;
+	if (setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeo, sizeof(timeo)) < 0){
+		perror("setsockopt");
+		fprintf(stderr, "%s: Error setting SO_RCVTIMEO to control connection.\n", __FUNCTION__);
+		goto err;
+	}
+
+	// Read up to the line break
+	while (!got || (line[got-1] != '\n')){
+		if (got >= len-1){
+			fprintf(stderr, "%s: Error, session submission longer than %d bytes.\n", __FUNCTION__, len-1);
+			goto err;
+		}
+		if ((i = read(client_fd, line+got, len-1-got)) <= 0){
+			if (i < 0){
+				perror("read");
+			}
+			fprintf(stderr, "%s: Error reading session submission.\n", __FUNCTION__);
+			goto err;
+		}
+		got += i;
+	}
+	line[got-1] = 0;
+
+	if (verbose > 0){
+		printf("%s: Received session submission '%s'.\n", __FUNCTION__, line);
+		fflush(stdout);
+	}
+
+out:
+	// Return
+	return(client_fd);
+
+err:
+	if (client_fd >= 0){
+		close(client_fd);
+		client_fd = -1;
+	}
+	goto out;
+}
+
+/*
+ * int
+ * control_split(char *line, char **argv, int max);
+ * ------------------------------------------------
+ *  This function splits 'line' on blanks into at most 'max' arguments,
+ *  pointing the entries of 'argv' into 'line'. 'argv' is NULL terminated, so
+ *  it must have room for 'max'+1 entries.
+ *
+ *  Mandatory params: line, argv, max
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Too many arguments
+ *   >=0 Number of arguments
+ */
+int
+control_split(char *line, char **argv, int max){
+	// Local variables
+	char                    *saveptr = NULL;        // strtok_r() state
+	char                    *arg;                   // Current argument
+	int                     argc = 0;               // Number of arguments
+
+	for (arg = strtok_r(line, " \t", &saveptr); arg; arg = strtok_r(NULL, " \t", &saveptr)){
+		if (argc >= max){
+			fprintf(stderr, "%s: Error, more than %d arguments in session submission.\n", __FUNCTION__, max);
+			return(-1);
+		}
+		argv[argc++] = arg;
+	}
+	argv[argc] = NULL;
+	return(argc);
+}
+
+/*
+ * int
+ * control_submit(char *path, char *line);
+ * ---------------------------------------
+ *  This function submits the session described by 'line' to the persistent
+ *  master listening on the control socket at 'path'. The output of the
+ *  session is relayed to stdout until the master reports how it went.
+ *
+ *  Mandatory params: path, line
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error or failed session
+ *    0 Successful session
+ */
+int
+control_submit(char *path, char *line){
+	// Local variables
+	struct sockaddr_un      addr;                   // Control socket address
+	int                     control_fd = -1;        // Control socket
+	FILE                    *control_fp = NULL;     // Control socket stream
+	char                    buf[SYNEXEC_MASTER_CONTROL_LINE];// Relayed output
+	int                     err = -1;               // Return code
+
+	if (unix_addr(path, &addr) < 0){
+		goto out;
+	}
+	if ((control_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0){
+		perror("socket");
+		fprintf(stderr, "%s: Error creating control socket.\n", __FUNCTION__);
+		goto out;
+	}
+	if (connect(control_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		perror("connect");
+		fprintf(stderr, "%s: Error connecting to master at '%s'.\n", __FUNCTION__, path);
+		goto out;
+	}
+	if ((control_fp = fdopen(control_fd, "r+")) == NULL){
+		perror("fdopen");
+		fprintf(stderr, "%s: Error opening control socket stream.\n", __FUNCTION__);
+		goto out;
+	}
+	control_fd = -1;
+
+	// Send the submission
+	if ((fprintf(control_fp, "%s\n", line) < 0) || (fflush(control_fp) != 0)){
+		perror("fprintf");
+		fprintf(stderr, "%s: Error sending session submission.\n", __FUNCTION__);
+		goto out;
+	}
+
+	// Relay the output, the last line tells how the session went
+	while (fgets(buf, sizeof(buf), control_fp)){
+		if (!strcmp(buf, SYNEXEC_MASTER_CONTROL_OK "\n")){
+			err = 0;
+			break;
+		}
+		if (!strcmp(buf, SYNEXEC_MASTER_CONTROL_FAILED "\n")){
+			break;
+		}
+		fputs(buf, stdout);
+		fflush(stdout);
+	}
+	if (feof(control_fp)){
+		fprintf(stderr, "%s: Master closed the control connection.\n", __FUNCTION__);
+	}
+
+out:
+	// Free local resources
+	if (control_fp){
+		fclose(control_fp);
+	}
+	if (control_fd >= 0){
+		close(control_fd);
+	}
+
+	// Return
+	return(err);
+}
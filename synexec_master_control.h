@@ -0,0 +1,49 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_master_control.h
+ * --------------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+#ifndef SYNEXEC_MASTER_CONTROL_H
+#define SYNEXEC_MASTER_CONTROL_H
+
+// Global definitions
+#define SYNEXEC_MASTER_CONTROL_LOG      "/tmp/synexec_master.log"       // Default log of a daemonised master
+#define SYNEXEC_MASTER_CONTROL_LINE     4096    // Longest session submission (bytes)
+#define SYNEXEC_MASTER_CONTROL_ARGS     64      // Most arguments in a session submission
+#define SYNEXEC_MASTER_CONTROL_TIMEO    5       // Time for a client to send its submission (secs)
+#define SYNEXEC_MASTER_CONTROL_OK       "SYNEXEC SESSION OK"            // Last line of a successful session
+#define SYNEXEC_MASTER_CONTROL_FAILED   "SYNEXEC SESSION FAILED"        // Last line of a failed session
+
+// Related functions
+int
+control_listen(char *path);
+
+int
+control_accept(int control_fd, char *line, int len);
+
+int
+control_split(char *line, char **argv, int max);
+
+int
+control_submit(char *path, char *line);
+
+#endif /* SYNEXEC_MASTER_CONTROL_H */
@@ -27,12 +27,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/epoll.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include "synexec_master_slaveset.h"
 #include "synexec_master_comm.h"
+#include "synexec_comm.h"
+#include "synexec_master_batch.h"
 #include "synexec_common.h"
 
 // Global variables
@@ -62,6 +67,11 @@ slave_remove(slaveset_t *slaveset, slave_t *slave_aux){
 	// Check if its the first slave
 	if (!memcmp(slaveset->slave, slave_aux, sizeof(*slave_aux))){
 		slave_aux_a = slave_aux->next;
+		if (slave_aux->out_fp){
+			fclose(slave_aux->out_fp);
+		}
+		free(slave_aux->runs);
+		free(slave_aux->inst);
 		free(slave_aux);
 		slaveset->slave = slave_aux_a;
 		ret = 1;
@@ -74,6 +84,11 @@ slave_remove(slaveset_t *slaveset, slave_t *slave_aux){
 	while(slave_aux_a){
 		if (!memcmp(slave_aux_a, slave_aux, sizeof(*slave_aux))){
 			slave_aux_b->next = slave_aux_a->next;
+			if (slave_aux->out_fp){
+				fclose(slave_aux->out_fp);
+			}
+			free(slave_aux->runs);
+			free(slave_aux->inst);
 			free(slave_aux);
 			ret = 1;
 			goto out;
@@ -87,12 +102,83 @@ out:
 	return(ret);
 }
 
+/*
+ * int
+ * slaveset_init(slaveset_t *slaveset);
+ * ------------------------------------
+ *  This function initialises an empty 'slaveset', creating the epoll instance
+ *  used to wait on the sockets of its slaves.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+int
+slaveset_init(slaveset_t *slaveset){
+	// Local variables
+	int32_t                 slaves;                 // Slaves required
+	int                     err = 0;                // Return code
+
+	// Reset the set, keeping the number of slaves required
+	slaves = slaveset->slaves;
+	memset(slaveset, 0, sizeof(*slaveset));
+	slaveset->slaves = slaves;
+
+	// Create epoll instance
+	if ((slaveset->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0){
+		perror("epoll_create1");
+		fprintf(stderr, "%s: Error creating epoll instance.\n", __FUNCTION__);
+		goto err;
+	}
+
+out:
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	goto out;
+}
+
+/*
+ * void
+ * slaveset_purge(slaveset_t *slaveset);
+ * -------------------------------------
+ *  This function removes all slaves marked as SLAVE_STATE_DEAD from
+ *  'slaveset'. Their sockets must have already been closed.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+slaveset_purge(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave_aux;             // Auxiliary slave_t
+	slave_t                 *slave_aux_b;           // Auxiliary slave_t
+
+	slave_aux = slaveset->slave;
+	while(slave_aux){
+		slave_aux_b = slave_aux->next;
+		if (slave_aux->state == SLAVE_STATE_DEAD){
+			slave_remove(slaveset, slave_aux);
+		}
+		slave_aux = slave_aux_b;
+	}
+}
+
 /*
  * int
  * slaveset_probe(slaveset_t *slaveset);
  * -------------------------------------
  *  This function pings all slaves in slaveset and removes unresponding
- *  slaves from the list. It returns the number of slaves that responded.
+ *  slaves from the list. The replies are also used to refresh the clock
+ *  offset of each slave. It returns the number of slaves that responded.
  *
  *  Mandatory params: slaveset
  *  Optional params :
@@ -104,32 +190,55 @@ int
 slaveset_probe(slaveset_t *slaveset){
 	// Local variables
 	slave_t                 *slave_aux;             // Auxiliary slave_t
-	slave_t                 *slave_aux_b;           // Auxiliary slave_t
 
-	// Run through all the slaves in the set, counting
-	slaveset->active = 0;
 	if (verbose > 1){
 		printf("%s: Validating current slaveset.\n", __FUNCTION__);
 		fflush(stdout);
 	}
+
+	// Send the first probe to all slaves at once
+	slaveset->pending = 0;
+	slaveset->failed = 0;
+	slave_aux = slaveset->slave;
+	while(slave_aux){
+		slave_aux->state = SLAVE_STATE_PROBE;
+		slave_aux->probes = SYNEXEC_MASTER_COMM_SYNC_ROUNDS;
+		slaveset->pending++;
+		if (slave_probe(slave_aux, 1) < 0){
+			slave_aux->probes = 0;
+		}
+		slave_aux = slave_aux->next;
+	}
+	if (batch_flush() > 0){
+		slave_aux = slaveset->slave;
+		while (slave_aux){
+			if (slave_aux->batch_err){
+				slave_aux->batch_err = 0;
+				slave_aux->probes = 0;
+			}
+			slave_aux = slave_aux->next;
+		}
+	}
+
+	// Collect replies, then remove the slaves that did not answer in time
+	(void)slaveset_wait(slaveset, -1, SYNEXEC_MASTER_COMM_PROBE_WAIT * 1000);
 	slave_aux = slaveset->slave;
 	while(slave_aux){
-		if (slave_probe(slave_aux) < 0){
-			// Close its socket
+		if (slave_aux->state == SLAVE_STATE_PROBE){
+//printf("Removing dead slave: '%s:%hu'\n", inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
 			if (slave_aux->slave_fd >= 0){
-				(void)close(slave_aux->slave_fd);
+				(void)comm_close(slave_aux->slave_fd);
 				slave_aux->slave_fd = -1;
 			}
-			slave_aux_b = slave_aux->next;
-//printf("Removing dead slave: '%s:%hu'\n", inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
-			slave_remove(slaveset, slave_aux);
-			slave_aux = slave_aux_b;
-		}else{
-			slaveset->active++;
-//printf("Worker alive: '%s:%hu'\n", inet_ntoa(slave_aux->slave_addr.sin_addr), ntohs(slave_aux->slave_addr.sin_port));
-			slave_aux = slave_aux->next;
+			slave_aux->state = SLAVE_STATE_DEAD;
+			if (slave_aux->joined){
+				slaveset->active--;
+			}
 		}
+		slave_aux = slave_aux->next;
 	}
+	slaveset_purge(slaveset);
+	slaveset->pending = 0;
 
 	// Return number of slaves alive
 	return(slaveset->active);
@@ -174,7 +283,9 @@ slave_in_list(slaveset_t *slaveset, struct sockaddr_in *slave_addr){
  * slave_add(slaveset_t *slaveset, struct sockaddr_in *slave_addr,
  *           int slave_sock);
  * ---------------------------------------------------------------
- *  This function adds 'slave_addr' and 'slave_sock' to 'slaveset'.
+ *  This function adds 'slave_addr' and 'slave_sock' to 'slaveset' and
+ *  registers the socket with the epoll instance of the set. On error, the
+ *  socket is closed.
  *
  *  Mandatory params: slaveset, slave_addr, slave_sock
  *  Optional params :
@@ -188,6 +299,7 @@ int
 slave_add(slaveset_t *slaveset, struct sockaddr_in *slave_addr, int slave_sock){
 	// Local variables
 	slave_t                 *slave_aux = NULL;      // Auxiliary slave_t
+	struct epoll_event      event;                  // epoll registration
 	int                     err = 0;                // Return code
 
 	// Check if already in list
@@ -209,6 +321,20 @@ slave_add(slaveset_t *slaveset, struct sockaddr_in *slave_addr, int slave_sock){
 	// Fill slave contents
 	memcpy(&(slave_aux->slave_addr), slave_addr, sizeof(struct sockaddr_in));
 	slave_aux->slave_fd = slave_sock;
+	slave_aux->tx_fd = -1;
+	slave_aux->state = SLAVE_STATE_HELLO;
+	slave_aux->clock_error = -1;
+	slave_aux->status = -1;
+
+	// Wait for its hello on the epoll instance
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = slave_aux;
+	if (epoll_ctl(slaveset->epfd, EPOLL_CTL_ADD, slave_sock, &event) < 0){
+		perror("epoll_ctl");
+		fprintf(stderr, "%s: Error adding slave socket to epoll set.\n", __FUNCTION__);
+		goto err;
+	}
 
 	// Insert it into list
 	slave_aux->next = slaveset->slave;
@@ -230,17 +356,399 @@ err:
 	goto out;
 }
 
+/*
+ * static void
+ * slave_instances(slave_t *slave, int64_t *fleet);
+ * ------------------------------------------------
+ *  This function prints the results of each task instance run by 'slave'
+ *  (CPU, run time, exit status, CPU time and peak RSS), followed by the
+ *  minimum, mean and maximum run time of its instances, the spread of their
+ *  start times and how many failed. The instance run times are accumulated
+ *  in 'fleet' (0-count, 1-failed, 2-minimum, 3-maximum, 4-sum).
+ *
+ *  Mandatory params: slave, fleet
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+slave_instances(slave_t *slave, int64_t *fleet){
+	// Local variables
+	slave_inst_t            *inst;                  // Temporary instance
+	int64_t                 min = 0, max = 0, sum = 0;// Run times (nsecs)
+	struct timespec         *start[2] = {NULL};     // Earliest and latest start
+	int                     failed = 0;             // Instances that failed
+	int                     i;                      // Temporary integer
+
+	for (i=0; i<slave->inst_count; i++){
+		inst = &slave->inst[i];
+		printf("  instance %d", i);
+		if (inst->cpu >= 0){
+			printf(" (cpu %d)", inst->cpu);
+		}
+		printf(", %" PRId64 " ns", inst->elapsed);
+		if (WIFSIGNALED(inst->status)){
+			printf(", killed by signal %d", WTERMSIG(inst->status));
+		}else{
+			printf(", exit status %d", WEXITSTATUS(inst->status));
+		}
+		printf(", cpu %ld.%06ld s user + %ld.%06ld s sys, max rss %ld KiB\n",
+		       inst->rusage.ru_utime.tv_sec, inst->rusage.ru_utime.tv_usec,
+		       inst->rusage.ru_stime.tv_sec, inst->rusage.ru_stime.tv_usec,
+		       inst->rusage.ru_maxrss);
+
+		// Aggregate them
+		min = (!i || (inst->elapsed < min))?inst->elapsed:min;
+		max = (!i || (inst->elapsed > max))?inst->elapsed:max;
+		sum += inst->elapsed;
+		failed += (inst->status != 0);
+		if (!start[0] || (ts_diff_nsec(&inst->time[0], start[0]) < 0)){
+			start[0] = &inst->time[0];
+		}
+		if (!start[1] || (ts_diff_nsec(&inst->time[0], start[1]) > 0)){
+			start[1] = &inst->time[0];
+		}
+		fleet[2] = (!fleet[0] || (inst->elapsed < fleet[2]))?inst->elapsed:fleet[2];
+		fleet[3] = (!fleet[0] || (inst->elapsed > fleet[3]))?inst->elapsed:fleet[3];
+		fleet[4] += inst->elapsed;
+		fleet[1] += (inst->status != 0);
+		fleet[0]++;
+	}
+	if (slave->inst_count){
+		printf("  %d instances: run time min %" PRId64 " ns, mean %" PRId64 " ns, max %" PRId64 " ns"
+		       ", start spread %" PRId64 " ns, %d failed\n", slave->inst_count,
+		       min, sum / slave->inst_count, max, ts_diff_nsec(start[1], start[0]), failed);
+	}
+}
+
+/*
+ * void
+ * slave_times(slaveset_t *slaveset);
+ * ----------------------------------
+ *  This function prints the execution times reported by each slave in
+ *  'slaveset', already translated to the master clock, together with the
+ *  estimated clock offset of each slave. The run time is the one measured by
+ *  the slave on its monotonic clock, so it is not affected by clock steps. For slaves given a start deadline,
+ *  it also prints how far from the deadline they actually started. The exec
+ *  latency is the time from the start until the worker called execv(). The
+ *  conf ack is the time the slave took to receive and accept the configuration
+ *  file. When the slave reported them, the exit status and resource usage of
+ *  the worker (CPU time, peak RSS, page faults, context switches and block
+ *  I/O) are printed on a second line, which helps telling whether a slow slave
+ *  was starved of CPU, swapping or waiting on I/O. Slaves flagged as
+ *  stragglers are marked as such, and slaves that were given up on are listed
+ *  as unfinished and left out of the spread. When the tasks were signalled
+ *  after a fixed duration, the signal skew is how far from the deadline each
+ *  slave delivered it. Finally, it prints the spread of start, finish (and
+ *  signal delivery) times across the set. For tasks run as several instances
+ *  per slave, the results of every instance are listed under their slave
+ *  (see slave_instances()) and summarised across the set.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
 void
 slave_times(slaveset_t *slaveset){
-	slave_t *slave;
+	slave_t                 *slave;                 // Temporary slave
+	struct timespec         *start[2] = {NULL};     // Earliest and latest start
+	struct timespec         *finish[2] = {NULL};    // Earliest and latest finish
+	struct timespec         *stop[2] = {NULL};      // Earliest and latest signal delivery
+	int                     unfinished = 0;         // Slaves given up on
+	int64_t                 fleet[5] = {0};         // Instance run times across the set
 
 	slave = slaveset->slave;
 	while (slave){
-		printf("Slave %s:%hu, %ld.%ld -> %ld.%ld\n",
+		if (slave->state == SLAVE_STATE_LATE){
+			printf("Slave %s:%hu, UNFINISHED (%s)",
+			       inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port),
+			       slave->straggler?"straggler":"timed out");
+			if (slave->beat_elapsed){
+				printf(", last seen running for %" PRId64 " ns", slave->beat_elapsed);
+			}
+			printf("\n");
+			fflush(stdout);
+			unfinished++;
+			slave = slave->next;
+			continue;
+		}
+		printf("Slave %s:%hu, %ld.%09ld -> %ld.%09ld (%" PRId64 " ns)%s",
 		       inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port),
-		       slave->slave_time[0].tv_sec, slave->slave_time[0].tv_usec,
-		       slave->slave_time[1].tv_sec, slave->slave_time[1].tv_usec);
+		       (long)slave->slave_time[0].tv_sec, slave->slave_time[0].tv_nsec,
+		       (long)slave->slave_time[1].tv_sec, slave->slave_time[1].tv_nsec,
+		       slave->elapsed, slave->straggler?" STRAGGLER":"");
+		if (slave->conf_time[1].tv_sec || slave->conf_time[1].tv_nsec){
+			printf(", conf ack %" PRId64 " ns%s",
+			       ts_diff_nsec(&slave->conf_time[1], &slave->conf_time[0]),
+			       (slave->conf_miss == 0)?" (cached)":((slave->conf_miss == 2)?" (from peer)":""));
+		}
+		if (slave->clock_error >= 0){
+			printf(", clock offset %+" PRId64 " +/- %" PRId64 " ns",
+			       slave->clock_offset, slave->clock_error);
+		}
+		if (slave->exec_time[0].tv_sec || slave->exec_time[0].tv_nsec){
+			printf(", start skew %+" PRId64 " ns",
+			       ts_diff_nsec(&slave->exec_time[1], &slave->exec_time[0]));
+		}
+		if (slave->exec_time[2].tv_sec || slave->exec_time[2].tv_nsec){
+			printf(", exec latency %" PRId64 " ns",
+			       ts_diff_nsec(&slave->exec_time[2], &slave->exec_time[1]));
+		}
+		if (slave->stop_time.tv_sec || slave->stop_time.tv_nsec){
+			printf(", signal skew %+" PRId64 " ns",
+			       ts_diff_nsec(&slave->stop_time, &slaveset->stop_time));
+		}else
+		if (slave->stop_errno){
+			printf(", signal not delivered (%s)", strerror(slave->stop_errno));
+		}
+		printf("\n");
+		if (slave->status >= 0){
+			if (WIFSIGNALED(slave->status)){
+				printf("  killed by signal %d", WTERMSIG(slave->status));
+			}else{
+				printf("  exit status %d", WEXITSTATUS(slave->status));
+			}
+			printf(", cpu %ld.%06ld s user + %ld.%06ld s sys, max rss %ld KiB"
+			       ", faults %ld minor + %ld major, ctx switches %ld vol + %ld invol"
+			       ", block i/o %ld in + %ld out\n",
+			       slave->rusage.ru_utime.tv_sec, slave->rusage.ru_utime.tv_usec,
+			       slave->rusage.ru_stime.tv_sec, slave->rusage.ru_stime.tv_usec,
+			       slave->rusage.ru_maxrss, slave->rusage.ru_minflt, slave->rusage.ru_majflt,
+			       slave->rusage.ru_nvcsw, slave->rusage.ru_nivcsw,
+			       slave->rusage.ru_inblock, slave->rusage.ru_oublock);
+		}
+		slave_instances(slave, fleet);
 		fflush(stdout);
+
+		// Track the spread of start and finish times
+		if (!start[0] || (ts_diff_nsec(&slave->slave_time[0], start[0]) < 0)){
+			start[0] = &slave->slave_time[0];
+		}
+		if (!start[1] || (ts_diff_nsec(&slave->slave_time[0], start[1]) > 0)){
+			start[1] = &slave->slave_time[0];
+		}
+		if (!finish[0] || (ts_diff_nsec(&slave->slave_time[1], finish[0]) < 0)){
+			finish[0] = &slave->slave_time[1];
+		}
+		if (!finish[1] || (ts_diff_nsec(&slave->slave_time[1], finish[1]) > 0)){
+			finish[1] = &slave->slave_time[1];
+		}
+		if (slave->stop_time.tv_sec || slave->stop_time.tv_nsec){
+			if (!stop[0] || (ts_diff_nsec(&slave->stop_time, stop[0]) < 0)){
+				stop[0] = &slave->stop_time;
+			}
+			if (!stop[1] || (ts_diff_nsec(&slave->stop_time, stop[1]) > 0)){
+				stop[1] = &slave->stop_time;
+			}
+		}
+		slave = slave->next;
+	}
+
+	if (start[0]){
+		printf("Spread across slaves: start %" PRId64 " ns, finish %" PRId64 " ns",
+		       ts_diff_nsec(start[1], start[0]), ts_diff_nsec(finish[1], finish[0]));
+		if (stop[0]){
+			printf(", signal %" PRId64 " ns", ts_diff_nsec(stop[1], stop[0]));
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	if (fleet[0]){
+		printf("All %" PRId64 " instances: run time min %" PRId64 " ns, mean %" PRId64 " ns, max %" PRId64 " ns, %" PRId64 " failed\n",
+		       fleet[0], fleet[2], fleet[4] / fleet[0], fleet[3], fleet[1]);
+		fflush(stdout);
+	}
+	if (unfinished){
+		printf("Partial results: %d of %d slaves did not finish.\n", unfinished, slaveset->active);
+		fflush(stdout);
+	}
+}
+
+/*
+ * int
+ * slaveset_runs(slaveset_t *slaveset, int iterations);
+ * ----------------------------------------------------
+ *  This function prepares 'slaveset' to record the run times of 'iterations'
+ *  executions of the same configuration, for each slave and for the set.
+ *
+ *  Mandatory params: slaveset, iterations
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+int
+slaveset_runs(slaveset_t *slaveset, int iterations){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	int                     err = 0;                // Return code
+
+	// Discard the run times of a previous session
+	free(slaveset->fleet_runs);
+	slave = slaveset->slave;
+	while (slave){
+		free(slave->runs);
+		slave->runs = NULL;
+		slave = slave->next;
+	}
+
+	slaveset->iterations = iterations;
+	slaveset->iteration = 0;
+	if ((slaveset->fleet_runs = calloc(iterations, sizeof(int64_t))) == NULL){
+		perror("calloc");
+		fprintf(stderr, "%s: Error allocating run times for %d iterations.\n", __FUNCTION__, iterations);
+		goto err;
+	}
+	slave = slaveset->slave;
+	while (slave){
+		if ((slave->runs = calloc(iterations, sizeof(int64_t))) == NULL){
+			perror("calloc");
+			fprintf(stderr, "%s: Error allocating run times for %d iterations.\n", __FUNCTION__, iterations);
+			goto err;
+		}
+		slave = slave->next;
+	}
+
+out:
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	goto out;
+}
+
+/*
+ * void
+ * slaveset_record(slaveset_t *slaveset);
+ * --------------------------------------
+ *  This function records the run times of the execution that just finished
+ *  and moves on to the next iteration. Each slave's run time is the one it
+ *  measured itself, while the fleet-wide run time goes from the earliest start
+ *  to the latest finish across the set, in the master clock. Slaves that did
+ *  not finish are recorded as such and left out.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+slaveset_record(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	struct timespec         *start = NULL;          // Earliest start
+	struct timespec         *finish = NULL;         // Latest finish
+
+	if (slaveset->iteration >= slaveset->iterations){
+		return;
+	}
+
+	slave = slaveset->slave;
+	while (slave){
+		if (slave->state != SLAVE_STATE_DONE){
+			slave->runs[slaveset->iteration] = -1;
+			slave = slave->next;
+			continue;
+		}
+		slave->runs[slaveset->iteration] = slave->elapsed;
+		if (!start || (ts_diff_nsec(&slave->slave_time[0], start) < 0)){
+			start = &slave->slave_time[0];
+		}
+		if (!finish || (ts_diff_nsec(&slave->slave_time[1], finish) > 0)){
+			finish = &slave->slave_time[1];
+		}
+		slave = slave->next;
+	}
+	slaveset->fleet_runs[slaveset->iteration] = start?ts_diff_nsec(finish, start):-1;
+
+	printf("Iteration %d of %d, fleet-wide run time %" PRId64 " ns\n",
+	       slaveset->iteration+1, slaveset->iterations, slaveset->fleet_runs[slaveset->iteration]);
+	fflush(stdout);
+	slaveset->iteration++;
+}
+
+/*
+ * static void
+ * runs_stats(char *label, int64_t *runs, int n);
+ * ----------------------------------------------
+ *  This function prints the mean, standard deviation, minimum, median, 90th
+ *  and 99th percentiles (nearest rank) and maximum of the 'n' run times in
+ *  'runs', leaving out unfinished ones. 'runs' is sorted in place.
+ *
+ *  Mandatory params: label, runs, n
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+runs_stats(char *label, int64_t *runs, int n){
+	// Local variables
+	double                  mean = 0;               // Mean run time
+	double                  var = 0;                // Sample variance of the run times
+	int                     count;                  // Finished runs
+	int                     i;                      // Temporary integer
+
+	qsort(runs, n, sizeof(*runs), int64_cmp);
+	for (i=0; (i < n) && (runs[i] < 0); i++);
+	runs += i;
+	count = n - i;
+	if (count == 0){
+		printf("%s, no finished runs\n", label);
+		return;
+	}
+
+	for (i=0; i<count; i++){
+		mean += runs[i];
+	}
+	mean /= count;
+	for (i=0; i<count; i++){
+		var += (runs[i] - mean) * (runs[i] - mean);
+	}
+	if (count > 1){
+		var /= count - 1;
+	}
+
+	printf("%s, %d runs: mean %.0f ns, stddev %.0f ns, min %" PRId64 " ns, p50 %" PRId64 " ns"
+	       ", p90 %" PRId64 " ns, p99 %" PRId64 " ns, max %" PRId64 " ns\n",
+	       label, count, mean, sqrt(var), runs[0],
+	       runs[(count*50 + 99)/100 - 1], runs[(count*90 + 99)/100 - 1],
+	       runs[(count*99 + 99)/100 - 1], runs[count-1]);
+}
+
+/*
+ * void
+ * slaveset_stats(slaveset_t *slaveset);
+ * -------------------------------------
+ *  This function prints the statistics of the run times recorded over the
+ *  iterations of the session (see slaveset_record()), for each slave and for
+ *  the whole set.
+ *
+ *  Mandatory params: slaveset
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+slaveset_stats(slaveset_t *slaveset){
+	// Local variables
+	slave_t                 *slave;                 // Temporary slave
+	char                    label[64];              // Line label
+
+	slave = slaveset->slave;
+	while (slave){
+		snprintf(label, sizeof(label), "Slave %s:%hu",
+		         inet_ntoa(slave->slave_addr.sin_addr), ntohs(slave->slave_addr.sin_port));
+		runs_stats(label, slave->runs, slaveset->iteration);
 		slave = slave->next;
 	}
+	runs_stats("Fleet-wide", slaveset->fleet_runs, slaveset->iteration);
+	fflush(stdout);
 }
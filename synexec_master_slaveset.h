@@ -27,13 +27,73 @@
 
 // Header files
 #include <inttypes.h>
+#include <sys/types.h>
 #include <netinet/in.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "synexec_common.h"
+
+// Slave states
+#define SLAVE_STATE_HELLO       0                       // Connected, waiting for hello
+#define SLAVE_STATE_PROBE       1                       // Timestamped probes in flight
+#define SLAVE_STATE_IDLE        2                       // Joined, nothing in flight
+#define SLAVE_STATE_CONF        3                       // Configuration sent, waiting for CONF_OK
+#define SLAVE_STATE_READY       4                       // Configured
+#define SLAVE_STATE_RUNNING     5                       // Execution requested, waiting for FINISHD
+#define SLAVE_STATE_DONE        6                       // Execution finished
+#define SLAVE_STATE_DEAD        7                       // Connection lost, to be removed
+#define SLAVE_STATE_LATE        8                       // Gave up waiting for FINISHD
+
+// Task instance results
+typedef struct {
+	int                     cpu;                    // CPU it was pinned to, -1 if not pinned
+	struct timespec         time[2];                // 0-started, 1-finished
+	int64_t                 elapsed;                // Run time measured by the slave (nsecs)
+	int                     status;                 // Wait status
+	struct rusage           rusage;                 // Resource usage
+} slave_inst_t;
 
 // Slave entry
 typedef struct _slave {
 	struct sockaddr_in      slave_addr;             // Slave sockaddr
 	int                     slave_fd;               // TCP Socket
-	struct timeval          slave_time[3];          // 0-started, 1-finished, 2-zero for ref
+	int                     state;                  // SLAVE_STATE_*
+	int                     joined;                 // Counted in 'active' of the set
+	int                     probes;                 // Timestamped probes left in this round
+	struct timespec         slave_time[2];          // 0-started, 1-finished
+	int64_t                 elapsed;                // Run time measured by the slave (nsecs)
+	struct timespec         exec_time[3];           // 0-intended start, 1-actual start, 2-execv() called
+	struct timespec         run_time;               // Time the slave started running (MT_SYNEXEC_CLOCK_MONO)
+	int                     straggler;              // Ran longer than the straggler threshold
+	struct timespec         beat_time;              // Last heard from while running (MT_SYNEXEC_CLOCK_MONO)
+	int64_t                 beat_elapsed;           // Run time in the last heartbeat (nsecs)
+	int64_t                 beat_cpu;               // CPU time in the last heartbeat (nsecs)
+	int64_t                 beat_rss;               // Resident set size in the last heartbeat (KiB)
+	int                     beat_idle;              // Heartbeats in a row without CPU progress
+	int                     status;                 // Worker wait status, -1 if not reported
+	struct rusage           rusage;                 // Worker resource usage
+	int64_t                 *runs;                  // Run time of each iteration (nsecs), -1 if unfinished
+	char                    barrier[MT_SYNEXEC_BARRIER_NAME];// Barrier the slave waits on, empty if none
+	struct timespec         stop_time;              // Time the signal was delivered, zero if it was not
+	int                     stop_errno;             // Error delivering the signal, zero if none
+	FILE                    *out_fp;                // Task output file, NULL if not open
+	slave_inst_t            *inst;                  // Results of the task instances
+	int                     inst_count;             // Instances reported
+	int                     out_partial;            // Task output printed so far ends mid-line
+	int64_t                 clock_offset;           // Slave clock minus master clock (nsecs)
+	int64_t                 clock_error;            // Error bound of clock_offset (nsecs), -1 if unknown
+	struct timespec         conf_time[2];           // 0-configuration sent, 1-configuration acknowledged (MT_SYNEXEC_CLOCK_MONO)
+	int                     conf_miss;              // Configuration source: 0-cache, 1-master, 2-peer
+	int                     conf_wait;              // Waiting for its parent to get the configuration
+	int                     tree_index;             // Position in the distribution tree
+	synexec_fetch_t         fetch;                  // Where to fetch the configuration from
+	synexec_msg_t           tx_msg;                 // Header of the message being sent
+	char                    *tx_data;               // Payload of the message being sent
+	uint16_t                tx_datalen;             // Length of 'tx_data'
+	int                     tx_fd;                  // File streamed after the payload, -1 if none
+	uint64_t                tx_len;                 // Length of the message being sent (header + payload + file)
+	uint64_t                tx_off;                 // Bytes of the message already sent
+	char                    batch_err;             // Messages batched for it failed to reach it (see batch_flush())
 	struct _slave           *next;                  // Next slave in the linked list
 } slave_t;
 
@@ -42,9 +102,48 @@ typedef struct {
 	int32_t                 slaves;                 // Total number of slaves REQUIRED in the set
 	int32_t                 active;                 // Total number of slaves ACTIVE in the set
 	slave_t                 *slave;                 // Pointer to the first slave
+	int                     epfd;                   // epoll instance for all slave sockets
+	int32_t                 pending;                // Slaves yet to complete the current step
+	int32_t                 failed;                 // Slaves that failed the current step
+	int                     fanout;                 // Arity of the distribution tree, 0 to disable
+	uint32_t                heartbeat;              // Heartbeat interval while running (msecs), 0 to disable
+	uint32_t                timeout;                // Session run time limit (secs), 0 for none
+	uint32_t                slave_timeout;          // Slave run time limit (secs), 0 for none
+	double                  straggler;              // Multiple of the median run time that flags a straggler, 0 to disable
+	int                     partial;                // Give up on late slaves instead of failing the session
+	int                     failfast;               // Abort the session once a task fails
+	int                     abort;                  // 0-no, 1-abort requested, 2-aborting
+	char                    *output_dir;            // Directory for task output files, NULL to print it
+	int                     instances;              // Task instances per slave, zero for one per CPU
+	int                     pin;                    // Pin each instance to its own CPU
+	struct timespec         run_time;               // Time the slaves were told to start (MT_SYNEXEC_CLOCK_MONO)
+	uint32_t                start_delay;            // Delay of scheduled starts and barrier releases (msecs)
+	uint32_t                duration;               // Run time after which tasks are signalled (msecs), 0 for none
+	int                     signum;                 // Signal delivered once 'duration' elapsed
+	struct timespec         stop_time;              // Signal delivery deadline
+	char                    barrier[MT_SYNEXEC_BARRIER_NAME];// Barrier being released
+	struct timespec         barrier_time;           // Release deadline of that barrier, zero for immediate
+	struct timespec         barrier_span[2];        // Earliest and latest release reported by the slaves
+	int                     barrier_acks;           // Slaves yet to report releasing it
+	int                     iterations;             // Number of executions in the session
+	int                     iteration;              // Executions recorded so far
+	int64_t                 *fleet_runs;            // Fleet-wide run time of each iteration (nsecs), -1 if unfinished
+	slave_t                 **tree;                 // Distribution tree (NULL for dropped slaves)
+	int                     tree_len;               // Number of slaves in the tree
+	int                     conf_fd;                // Configuration file descriptor
+	char                    *conf_ptr;              // Configuration file mapping
+	off_t                   conf_len;               // Configuration file length
+	synexec_conf_t          conf;                   // Configuration hash (sent first)
+	synexec_stream_t        conf_stream;            // Header of a streamed configuration
 } slaveset_t;
 
 // Related functions
+int
+slaveset_init(slaveset_t *slaveset);
+
+void
+slaveset_purge(slaveset_t *slaveset);
+
 int
 slaveset_probe(slaveset_t *slaveset);
 
@@ -57,4 +156,13 @@ slave_add(slaveset_t *slaveset, struct sockaddr_in *slave_addr, int slave_sock);
 void
 slave_times(slaveset_t *slaveset);
 
+int
+slaveset_runs(slaveset_t *slaveset, int iterations);
+
+void
+slaveset_record(slaveset_t *slaveset);
+
+void
+slaveset_stats(slaveset_t *slaveset);
+
 #endif /* SYNEXEC_MASTER_SLAVESET_H */
@@ -34,19 +34,26 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <linux/fs.h>
 #include <pthread.h>
+#include <signal.h>
 
 #include "synexec_common.h"
 #include "synexec_comm.h"
 #include "synexec_slave_beacon.h"
 #include "synexec_slave_worker.h"
+#include "synexec_slave_peer.h"
+#include "synexec_slave_barrier.h"
 
 // Global variables
 uint32_t                session = 0;            // Session ID
 int                     verbose = 0;            // Verbose level
 char                    quit = 0;               // Global quit condition
+char                    stream_output = 0;      // Stream task output to the master
+int                     ring_output = 0;        // Keep this many KiB of task output in memory, 0 to disable
+char                    low_jitter = 0;         // Lock memory, raise the worker to SCHED_FIFO and spin just before a start
 
 // Print program usage
 static void
@@ -58,12 +65,19 @@ usage(char *argv0){
 	for (i=0; i<MT_PROGNAME_LEN+2; i++) fprintf(stderr, "-");
 	fprintf(stderr, "\n %s\n", MT_PROGNAME);
 	for (i=0; i<MT_PROGNAME_LEN+2; i++) fprintf(stderr, "-");
-	fprintf(stderr, "\nUsage: %s [ -hv ] [ -i <if_name> ] [-s <session> ]\n", argv0);
+	fprintf(stderr, "\nUsage: %s [ -hvoL ] [ -R <KiB> ] [ -i <if_name> ] [-s <session> ]\n", argv0);
+	fprintf(stderr, "       %s -B <name>\n", argv0);
 	fprintf(stderr, "       -h             Print this help message and quit.\n");
 	fprintf(stderr, "       -v             Increase verbosity (may be used multiple times).\n");
 	fprintf(stderr, "       -i <if_name>   Use interface <if_name> instead of default.\n");
 	fprintf(stderr, "       -p <port>      Override default network port (%hu) with <port>.\n", MT_NETPORT);
 	fprintf(stderr, "       -s <session>   Define session ID to <session> (unit32_t, default 0).\n");
+	fprintf(stderr, "       -o             Stream the output of tasks to the master instead of %s.\n", MT_SYNEXEC_SLAVE_OUTPUT);
+	fprintf(stderr, "       -R <KiB>       Keep the last <KiB> of task output in memory instead of %s,\n", MT_SYNEXEC_SLAVE_OUTPUT);
+	fprintf(stderr, "                      sending it to the master if the task fails or on request.\n");
+	fprintf(stderr, "       -L             Low jitter mode: lock memory, run the worker with real-time priority\n");
+	fprintf(stderr, "                      and spin for the last moments before a scheduled start.\n");
+	fprintf(stderr, "       -B <name>      From within a task, wait on barrier <name> until all slaves reach it.\n");
 }
 
 // Main
@@ -72,15 +86,17 @@ main(int argc, char **argv){
 	// Local variables
 	char                    *net_ifname = NULL;     // Interface name
 	uint16_t                net_port = 0;           // Network port we operate on
+	char                    *barrier = NULL;        // Barrier to enter
 
 	pthread_t               beacon_tid;             // Beacon pthread id
 	pthread_t               worker_tid;             // Worker pthread id
+	pthread_t               peer_tid;               // Peer pthread id
 
 	int                     i = 0;                  // Temporary integer
 	int                     err = 0;                // Return code
 
 	// Fetch arguments
-	while ((i = getopt(argc, argv, "hvi:p:s:")) != -1){
+	while ((i = getopt(argc, argv, "hvoLR:i:p:s:B:")) != -1){
 		switch (i){
 		case 'h':
 			// Print help
@@ -92,6 +108,36 @@ main(int argc, char **argv){
 			verbose++;
 			break;
 
+		case 'o':
+			// Stream task output to the master
+			if (stream_output == 1){
+				fprintf(stderr, "%s: Error, already set to stream task output.\n", argv[0]);
+				goto err;
+			}
+			stream_output = 1;
+			break;
+
+		case 'L':
+			// Enable low jitter mode
+			if (low_jitter == 1){
+				fprintf(stderr, "%s: Error, low jitter mode already set.\n", argv[0]);
+				goto err;
+			}
+			low_jitter = 1;
+			break;
+
+		case 'R':
+			// Set task output ring size, if unset
+			if (ring_output != 0){
+				fprintf(stderr, "%s: Error, output ring already set to %d KiB.\n", argv[0], ring_output);
+				goto err;
+			}else
+			if ((ring_output = atoi(optarg)) <= 0){
+				fprintf(stderr, "%s: Error, output ring size must be greater than zero.\n", argv[0]);
+				goto err;
+			}
+			break;
+
 		case 'i':
 			// Set interface name, if unset
 			if (net_ifname != NULL){
@@ -129,6 +175,15 @@ main(int argc, char **argv){
 			}
 			break;
 
+		case 'B':
+			// Set barrier to enter, if unset
+			if (barrier != NULL){
+				fprintf(stderr, "%s: Error, barrier already set to '%s'.\n", argv[0], barrier);
+				goto err;
+			}
+			barrier = optarg;
+			break;
+
 		default:
 			// Unknown option
 			fprintf(stderr, "\n");
@@ -136,6 +191,11 @@ main(int argc, char **argv){
 			goto err;
 		}
 	}
+	if (stream_output && ring_output){
+		fprintf(stderr, "%s: Error, task output is either streamed or kept in memory.\n", argv[0]);
+		goto err;
+	}
+
 	// Check for remaining parameters
 	if (argc != optind){
 		if (argc > optind+1){
@@ -145,6 +205,14 @@ main(int argc, char **argv){
 		goto err;
 	}
 
+	// Enter the barrier, if called from a task
+	if (barrier){
+		if (barrier_enter(barrier) != 0){
+			goto err;
+		}
+		goto out;
+	}
+
 	// Set default network port if none specified
 	if (net_port == 0){
 		net_port = MT_NETPORT;
@@ -162,6 +230,15 @@ main(int argc, char **argv){
 		goto err;
 	}
 
+	// Peers may go away while a configuration is streamed to them
+	signal(SIGPIPE, SIG_IGN);
+
+	// Keep the slave from faulting pages in on its way to a start
+	if (low_jitter && (mlockall(MCL_CURRENT|MCL_FUTURE) < 0)){
+		perror("mlockall");
+		fprintf(stderr, "%s: Unable to lock memory, carrying on without it.\n", argv[0]);
+	}
+
 	// Launch threads
 	if (pthread_create(&beacon_tid, NULL, &beacon, NULL) != 0){
 		perror("pthread_create");
@@ -173,10 +250,16 @@ main(int argc, char **argv){
 		fprintf(stderr, "%s: Error creating Worker thread.\n", argv[0]);
 		goto err;
 	}
+	if (pthread_create(&peer_tid, NULL, &peer, NULL) != 0){
+		perror("pthread_create");
+		fprintf(stderr, "%s: Error creating Peer thread.\n", argv[0]);
+		goto err;
+	}
 
 	// Wait for threads to finish
 	pthread_join(worker_tid, NULL);
 	pthread_join(beacon_tid, NULL);
+	pthread_join(peer_tid, NULL);
 
 	// Check if quit due to error
 	if (quit == 2){
@@ -0,0 +1,473 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_slave_barrier.c
+ * -------------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+// Header files
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+#include "synexec_common.h"
+#include "synexec_slave_worker.h"
+#include "synexec_slave_barrier.h"
+
+// Global variables
+extern int                      verbose;
+
+// Task process still sending the name of the barrier it enters
+typedef struct {
+	int             fd;                     // Task process socket
+	int             got;                    // Bytes of the name read
+	struct timespec since;                  // Time it connected (MT_SYNEXEC_CLOCK_MONO)
+	char            name[MT_SYNEXEC_BARRIER_NAME];
+} barrier_client_t;
+
+static int                      barrier_fd = -1;        // Barrier socket
+static int                      barrier_epfd = -1;      // Barrier socket and clients, polled by the slave
+static barrier_client_t         barrier_client[MT_SYNEXEC_SLAVE_BARRIER_MAX];// Task processes naming a barrier
+static int                      barrier_clients = 0;    // Number of task processes naming a barrier
+static int                      barrier_waiter[MT_SYNEXEC_SLAVE_BARRIER_MAX];// Task processes waiting
+static int                      barrier_waiters = 0;    // Number of task processes waiting
+static char                     barrier_name[MT_SYNEXEC_BARRIER_NAME];// Barrier they wait on
+
+/*
+ * int
+ * barrier_open(char *path);
+ * -------------------------
+ *  This function creates the barrier socket at 'path', on which the tasks run
+ *  by this slave enter fleet-wide barriers (see barrier_enter()).
+ *
+ *  Mandatory params: path
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *   >0 Descriptor to be polled for POLLIN, calling barrier_accept() when ready
+ */
+int
+barrier_open(char *path){
+	// Local variables
+	struct sockaddr_un      addr;                   // Barrier socket address
+	struct epoll_event      event;                  // epoll registration
+
+	if (unix_addr(path, &addr) < 0){
+		goto err;
+	}
+	if ((barrier_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0){
+		perror("socket");
+		fprintf(stderr, "%s: Error creating barrier socket.\n", __FUNCTION__);
+		goto err;
+	}
+	(void)unlink(path);
+	if (bind(barrier_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		perror("bind");
+		fprintf(stderr, "%s: Error binding barrier socket to '%s'.\n", __FUNCTION__, path);
+		goto err;
+	}
+	if (listen(barrier_fd, SOMAXCONN) < 0){
+		perror("listen");
+		fprintf(stderr, "%s: Error listening on barrier socket '%s'.\n", __FUNCTION__, path);
+		goto err;
+	}
+
+	// Watch it along with the task processes naming a barrier
+	if ((barrier_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0){
+		perror("epoll_create1");
+		fprintf(stderr, "%s: Error creating barrier epoll set.\n", __FUNCTION__);
+		goto err;
+	}
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = barrier_fd;
+	if (epoll_ctl(barrier_epfd, EPOLL_CTL_ADD, barrier_fd, &event) < 0){
+		perror("epoll_ctl");
+		fprintf(stderr, "%s: Error adding barrier socket to epoll set.\n", __FUNCTION__);
+		goto err;
+	}
+
+out:
+	// Return
+	return(barrier_epfd);
+
+err:
+	if (barrier_epfd >= 0){
+		close(barrier_epfd);
+		barrier_epfd = -1;
+	}
+	if (barrier_fd >= 0){
+		close(barrier_fd);
+		barrier_fd = -1;
+	}
+	goto out;
+}
+
+/*
+ * void
+ * barrier_cancel();
+ * -----------------
+ *  This function lets the task processes waiting on a barrier go without a
+ *  release, so they can tell it did not happen.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+barrier_cancel(){
+	while (barrier_waiters > 0){
+		close(barrier_waiter[--barrier_waiters]);
+	}
+}
+
+/*
+ * void
+ * barrier_close(char *path);
+ * --------------------------
+ *  This function removes the barrier socket at 'path', cancelling the barrier
+ *  in progress (see barrier_cancel()).
+ *
+ *  Mandatory params: path
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+void
+barrier_close(char *path){
+	barrier_cancel();
+	while (barrier_clients > 0){
+		close(barrier_client[--barrier_clients].fd);
+	}
+	if (barrier_epfd >= 0){
+		close(barrier_epfd);
+		barrier_epfd = -1;
+	}
+	if (barrier_fd >= 0){
+		close(barrier_fd);
+		barrier_fd = -1;
+		(void)unlink(path);
+	}
+}
+
+/*
+ * static void
+ * barrier_drop(int i);
+ * --------------------
+ *  This function turns away the task process naming a barrier in slot 'i' of
+ *  'barrier_client', which is then reused.
+ *
+ *  Mandatory params: i
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+barrier_drop(int i){
+	close(barrier_client[i].fd);
+	barrier_client[i] = barrier_client[--barrier_clients];
+}
+
+/*
+ * static int
+ * barrier_read(barrier_client_t *client);
+ * ---------------------------------------
+ *  This function reads what 'client' sent of the barrier name, a single line,
+ *  without blocking. Once the name is complete, the process waits on the
+ *  barrier until barrier_release() is called for it.
+ *
+ *  Mandatory params: client
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error (process to be turned away)
+ *    0 Name incomplete
+ *    1 Process now waiting on the barrier
+ */
+static int
+barrier_read(barrier_client_t *client){
+	// Local variables
+	char                    *name = client->name;   // Barrier name
+	int                     i;                      // Temporary integer
+
+	// Read what is there
+	if (client->got >= MT_SYNEXEC_BARRIER_NAME-1){
+		fprintf(stderr, "%s: Error, barrier name longer than %d bytes.\n", __FUNCTION__, MT_SYNEXEC_BARRIER_NAME-2);
+		return(-1);
+	}
+	if ((i = read(client->fd, name+client->got, MT_SYNEXEC_BARRIER_NAME-1-client->got)) < 0){
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)){
+			return(0);
+		}
+		perror("read");
+	}
+	if (i <= 0){
+		fprintf(stderr, "%s: Error reading barrier name.\n", __FUNCTION__);
+		return(-1);
+	}
+	client->got += i;
+	if (name[client->got-1] != '\n'){
+		return(0);
+	}
+	name[client->got-1] = 0;
+	if (!*name){
+		fprintf(stderr, "%s: Error, empty barrier name.\n", __FUNCTION__);
+		return(-1);
+	}
+
+	// Processes wait on one barrier at a time
+	if (barrier_waiters && strcmp(name, barrier_name)){
+		fprintf(stderr, "%s: Error, entering barrier '%s' while waiting on '%s'.\n", __FUNCTION__, name, barrier_name);
+		return(-1);
+	}
+	if (barrier_waiters >= MT_SYNEXEC_SLAVE_BARRIER_MAX){
+		fprintf(stderr, "%s: Error, more than %d processes waiting on barrier '%s'.\n", __FUNCTION__, MT_SYNEXEC_SLAVE_BARRIER_MAX, name);
+		return(-1);
+	}
+	(void)epoll_ctl(barrier_epfd, EPOLL_CTL_DEL, client->fd, NULL);
+	strcpy(barrier_name, name);
+	barrier_waiter[barrier_waiters++] = client->fd;
+
+	if (verbose > 0){
+		printf("%s: Task entered barrier '%s' (%d waiting).\n", __FUNCTION__, name, barrier_waiters);
+		fflush(stdout);
+	}
+	return(1);
+}
+
+/*
+ * int
+ * barrier_accept();
+ * -----------------
+ *  This function is called when the descriptor returned by barrier_open() is
+ *  ready. It accepts task processes entering a barrier and reads the names
+ *  they send, without blocking, so a slow or stuck task cannot hold up the
+ *  slave. Processes that have not sent a full name within
+ *  MT_SYNEXEC_SLAVE_BARRIER_TIMEO are turned away on a later call. Several
+ *  processes may wait on the same barrier (e.g. the instances of a task), and
+ *  it is reported to the master once all those still running have entered it
+ *  (see barrier_waiting()).
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   Number of processes waiting on the barrier
+ */
+int
+barrier_accept(){
+	// Local variables
+	struct epoll_event      events[MT_SYNEXEC_SLAVE_BARRIER_MAX];// Ready descriptors
+	struct epoll_event      event;                  // epoll registration
+	barrier_client_t        *client;                // Task process naming a barrier
+	struct timespec         now;                    // Current time (MT_SYNEXEC_CLOCK_MONO)
+	int                     fd;                     // Task process socket
+	int                     n;                      // Ready descriptors
+	int                     i, j;                   // Temporary integers
+
+	if ((n = epoll_wait(barrier_epfd, events, MT_SYNEXEC_SLAVE_BARRIER_MAX, 0)) < 0){
+		n = 0;
+	}
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+	for (i=0; i<n; i++){
+		// Accept the processes entering a barrier
+		if (events[i].data.fd == barrier_fd){
+			while ((fd = accept4(barrier_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0){
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.fd = fd;
+				if ((barrier_clients >= MT_SYNEXEC_SLAVE_BARRIER_MAX) ||
+				    (epoll_ctl(barrier_epfd, EPOLL_CTL_ADD, fd, &event) < 0)){
+					fprintf(stderr, "%s: Error, too many processes entering a barrier.\n", __FUNCTION__);
+					close(fd);
+					continue;
+				}
+				client = &barrier_client[barrier_clients++];
+				memset(client, 0, sizeof(*client));
+				client->fd = fd;
+				client->since = now;
+			}
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)){
+				perror("accept4");
+				fprintf(stderr, "%s: Error accepting barrier connection.\n", __FUNCTION__);
+			}
+			continue;
+		}
+
+		// Read the name they send
+		for (j=0; (j<barrier_clients) && (barrier_client[j].fd != events[i].data.fd); j++);
+		if (j == barrier_clients){
+			continue;
+		}
+		switch (barrier_read(&barrier_client[j])){
+		case -1:
+			barrier_drop(j);
+			break;
+		case 1:
+			barrier_client[j] = barrier_client[--barrier_clients];
+			break;
+		}
+	}
+
+	// Turn away those that did not send it in time
+	for (j=0; j<barrier_clients; ){
+		if (ts_diff_nsec(&now, &barrier_client[j].since) >= (int64_t)MT_SYNEXEC_SLAVE_BARRIER_TIMEO * 1000000000){
+			fprintf(stderr, "%s: Error, task process did not name a barrier in time.\n", __FUNCTION__);
+			barrier_drop(j);
+			continue;
+		}
+		j++;
+	}
+
+	// Return
+	return(barrier_waiters);
+}
+
+/*
+ * int
+ * barrier_waiting(char *name);
+ * ----------------------------
+ *  This function copies the name of the barrier task processes are waiting on
+ *  into 'name' (MT_SYNEXEC_BARRIER_NAME bytes), if any.
+ *
+ *  Mandatory params: name
+ *  Optional params :
+ *
+ *  Return values:
+ *   Number of processes waiting
+ */
+int
+barrier_waiting(char *name){
+	if (barrier_waiters){
+		strcpy(name, barrier_name);
+	}
+	return(barrier_waiters);
+}
+
+/*
+ * int
+ * barrier_release(char *name);
+ * ----------------------------
+ *  This function releases the task processes waiting on barrier 'name'.
+ *
+ *  Mandatory params: name
+ *  Optional params :
+ *
+ *  Return values:
+ *   Number of processes released
+ */
+int
+barrier_release(char *name){
+	// Local variables
+	int                     released = 0;           // Processes released
+
+	if (!barrier_waiters || strcmp(name, barrier_name)){
+		return(0);
+	}
+	while (barrier_waiters > 0){
+		if (write(barrier_waiter[--barrier_waiters], MT_SYNEXEC_SLAVE_BARRIER_GO, strlen(MT_SYNEXEC_SLAVE_BARRIER_GO)) > 0){
+			released++;
+		}
+		close(barrier_waiter[barrier_waiters]);
+	}
+	return(released);
+}
+
+/*
+ * int
+ * barrier_enter(char *name);
+ * --------------------------
+ *  This function is called from within a task to enter the fleet-wide barrier
+ *  'name'. It connects to the barrier socket of the slave running the task,
+ *  found in the MT_SYNEXEC_SLAVE_BARRIER_ENV environment variable, and blocks
+ *  until the master releases the barrier on all slaves.
+ *
+ *  Mandatory params: name
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error (barrier not released)
+ *    0 Barrier released
+ */
+int
+barrier_enter(char *name){
+	// Local variables
+	struct sockaddr_un      addr;                   // Barrier socket address
+	char                    *path;                  // Barrier socket path
+	char                    buf[8];                 // Release message
+	int                     fd = -1;                // Barrier socket
+	int                     err = -1;               // Return code
+
+	if ((path = getenv(MT_SYNEXEC_SLAVE_BARRIER_ENV)) == NULL){
+		fprintf(stderr, "%s: Error, %s is not set (not running under a slave?).\n", __FUNCTION__, MT_SYNEXEC_SLAVE_BARRIER_ENV);
+		goto out;
+	}
+	if ((strlen(name) > MT_SYNEXEC_BARRIER_NAME-2) || !*name || strchr(name, '\n')){
+		fprintf(stderr, "%s: Error, invalid barrier name '%s'.\n", __FUNCTION__, name);
+		goto out;
+	}
+	if (unix_addr(path, &addr) < 0){
+		goto out;
+	}
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0){
+		perror("socket");
+		fprintf(stderr, "%s: Error creating barrier socket.\n", __FUNCTION__);
+		goto out;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		perror("connect");
+		fprintf(stderr, "%s: Error connecting to barrier socket '%s'.\n", __FUNCTION__, path);
+		goto out;
+	}
+	if ((dprintf(fd, "%s\n", name) < 0)){
+		perror("dprintf");
+		fprintf(stderr, "%s: Error entering barrier '%s'.\n", __FUNCTION__, name);
+		goto out;
+	}
+
+	// Block until released
+	memset(buf, 0, sizeof(buf));
+	if ((read(fd, buf, sizeof(buf)-1) <= 0) || strcmp(buf, MT_SYNEXEC_SLAVE_BARRIER_GO)){
+		fprintf(stderr, "%s: Barrier '%s' was not released.\n", __FUNCTION__, name);
+		goto out;
+	}
+	err = 0;
+
+out:
+	if (fd >= 0){
+		close(fd);
+	}
+
+	// Return
+	return(err);
+}
@@ -0,0 +1,57 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_slave_barrier.h
+ * -------------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+#ifndef SYNEXEC_SLAVE_BARRIER_H
+#define SYNEXEC_SLAVE_BARRIER_H
+
+// Global definitions
+#define MT_SYNEXEC_SLAVE_BARRIER_PATH   "/tmp/synexec_barrier"  // Barrier socket (followed by the slave pid)
+#define MT_SYNEXEC_SLAVE_BARRIER_ENV    "SYNEXEC_BARRIER"       // Environment variable pointing tasks to it
+#define MT_SYNEXEC_SLAVE_BARRIER_MAX    MT_SYNEXEC_SLAVE_INSTANCES_MAX  // Task processes waiting on a barrier (one per instance)
+#define MT_SYNEXEC_SLAVE_BARRIER_TIMEO  1                       // Time for a task to name the barrier (secs)
+#define MT_SYNEXEC_SLAVE_BARRIER_GO     "GO\n"                  // Sent to the tasks on release
+
+// Related functions
+int
+barrier_open(char *path);
+
+void
+barrier_close(char *path);
+
+void
+barrier_cancel();
+
+int
+barrier_accept();
+
+int
+barrier_waiting(char *name);
+
+int
+barrier_release(char *name);
+
+int
+barrier_enter(char *name);
+
+#endif /* SYNEXEC_SLAVE_BARRIER_H */
@@ -0,0 +1,342 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_slave_cache.c
+ * -----------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+// Header files
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "synexec_common.h"
+#include "synexec_hash.h"
+#include "synexec_slave_cache.h"
+
+// Global variables
+extern int              verbose;
+
+/*
+ * Cache layout
+ * ------------
+ *  Each configuration file is kept in MT_SYNEXEC_SLAVE_CACHEDIR as two files
+ *  named after the hex SHA-256 of the whole file: '<hash>.cmd' holds the first
+ *  line (the command line) and '<hash>' holds the remainder, which is what
+ *  MT_SYNEXEC_CONF_TOKEN expands to. The hash of both together must match the
+ *  name, so an entry that was modified (e.g. by a worker) is never reused.
+ */
+
+/*
+ * static int
+ * cache_paths(synexec_conf_t *conf, char **cmd_fn, char **body_fn);
+ * -----------------------------------------------------------------
+ *  This function builds the names of the cache files for 'conf'. Both must be
+ *  free()d after use.
+ *
+ *  Mandatory params: conf, cmd_fn, body_fn
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+cache_paths(synexec_conf_t *conf, char **cmd_fn, char **body_fn){
+	// Local variables
+	char                    hex[SYNEXEC_HASH_HEXLEN];// Hash in hex
+
+	hash_hex(conf->hash, hex);
+	*cmd_fn = *body_fn = NULL;
+	if ((asprintf(cmd_fn, "%s%s.cmd", MT_SYNEXEC_SLAVE_CACHEDIR, hex) < 0) ||
+	    (asprintf(body_fn, "%s%s", MT_SYNEXEC_SLAVE_CACHEDIR, hex) < 0)){
+		perror("asprintf");
+		fprintf(stderr, "%s: Error allocating cache file names.\n", __FUNCTION__);
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*
+ * static int
+ * cache_verify(synexec_conf_t *conf, char *cmd, size_t cmd_len, char *body_fn);
+ * -----------------------------------------------------------------------------
+ *  This function checks that 'cmd_len' bytes of 'cmd' followed by the
+ *  contents of 'body_fn' match the length and hash in 'conf'.
+ *
+ *  Mandatory params: conf, cmd, body_fn
+ *  Optional params : cmd_len
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Contents do not match
+ *    1 Contents match
+ */
+static int
+cache_verify(synexec_conf_t *conf, char *cmd, size_t cmd_len, char *body_fn){
+	// Local variables
+	synexec_hash_t          ctx;                    // Hash context
+	uint8_t                 digest[SYNEXEC_HASH_LEN];// Computed hash
+	struct stat             sb;                     // Body file stats
+	int                     fd = -1;                // Body file descriptor
+	int                     err = 0;                // Return code
+
+	if ((fd = open(body_fn, O_RDONLY)) < 0){
+		goto out;
+	}
+	if (fstat(fd, &sb) < 0){
+		perror("fstat");
+		goto err;
+	}
+	if ((uint64_t)sb.st_size + cmd_len != conf->length){
+		goto out;
+	}
+
+	hash_init(&ctx);
+	hash_update(&ctx, cmd, cmd_len);
+	if (hash_fd(fd, &ctx) < 0){
+		goto err;
+	}
+	hash_final(&ctx, digest);
+	err = !memcmp(digest, conf->hash, sizeof(digest));
+
+out:
+	// Free resources
+	if (fd >= 0){
+		close(fd);
+	}
+
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	goto out;
+}
+
+/*
+ * int
+ * cache_lookup(synexec_conf_t *conf, char **cmd, char **path);
+ * ------------------------------------------------------------
+ *  This function looks for the configuration file described by 'conf' in the
+ *  cache. On a hit, '*cmd' is set to the (NUL-terminated) command line and
+ *  '*path' to the file holding the remainder of the configuration. Both must
+ *  be free()d after use. Entries that fail verification are removed.
+ *
+ *  Mandatory params: conf, cmd, path
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Miss
+ *    1 Hit
+ */
+int
+cache_lookup(synexec_conf_t *conf, char **cmd, char **path){
+	// Local variables
+	char                    *cmd_fn = NULL;         // Command line file name
+	char                    *body_fn = NULL;        // Remainder file name
+	FILE                    *cmd_fp = NULL;         // Command line file
+	char                    *line = NULL;           // Command line
+	size_t                  line_size = 0;          // Size of 'line' buffer
+	ssize_t                 line_len = 0;           // Length of command line
+	int                     err = 0;                // Return code
+
+	// Read the command line
+	if (cache_paths(conf, &cmd_fn, &body_fn) < 0){
+		goto err;
+	}
+	if ((cmd_fp = fopen(cmd_fn, "r")) == NULL){
+		goto out;
+	}
+	if ((line_len = getdelim(&line, &line_size, 0, cmd_fp)) <= 0){
+		goto stale;
+	}
+
+	// Verify the entry
+	switch (cache_verify(conf, line, line_len, body_fn)){
+	case 1:
+		break;
+	case 0:
+		goto stale;
+	default:
+		goto err;
+	}
+	if (verbose > 0){
+		printf("%s: Configuration found in cache as '%s'.\n", __FUNCTION__, body_fn);
+		fflush(stdout);
+	}
+	*cmd = line;
+	*path = body_fn;
+	line = body_fn = NULL;
+	err = 1;
+
+out:
+	// Free resources
+	if (cmd_fp){
+		fclose(cmd_fp);
+	}
+	if (line){
+		free(line);
+	}
+	if (cmd_fn){
+		free(cmd_fn);
+	}
+	if (body_fn){
+		free(body_fn);
+	}
+
+	// Return
+	return(err);
+
+stale:
+	// Remove entries that do not match their name
+	if (verbose > 0){
+		printf("%s: Removing stale cache entry '%s'.\n", __FUNCTION__, body_fn);
+		fflush(stdout);
+	}
+	(void)unlink(cmd_fn);
+	(void)unlink(body_fn);
+	goto out;
+
+err:
+	err = -1;
+	goto out;
+}
+
+/*
+ * int
+ * cache_store(synexec_conf_t *conf, char *cmd, char cmd_nl, char *conf_fn,
+ *             char **path);
+ * ------------------------------------------------------------------------
+ *  This function verifies that the configuration file received from the
+ *  master (command line 'cmd', followed by a line break if 'cmd_nl' is set,
+ *  followed by the contents of 'conf_fn') matches 'conf' and moves it into
+ *  the cache. Once 'conf_fn' is moved, '*path' is set to its new location,
+ *  which must be free()d after use. Otherwise '*path' is left untouched and
+ *  'conf_fn' can still be used.
+ *
+ *  Mandatory params: conf, cmd, conf_fn, path
+ *  Optional params : cmd_nl
+ *
+ *  Return values:
+ *   -1 Contents do not match 'conf'
+ *    0 Not cached
+ *    1 Cached
+ */
+int
+cache_store(synexec_conf_t *conf, char *cmd, char cmd_nl, char *conf_fn, char **path){
+	// Local variables
+	char                    *cmd_fn = NULL;         // Command line file name
+	char                    *body_fn = NULL;        // Remainder file name
+	char                    *tmp_fn = NULL;         // Temporary file name
+	char                    *line = NULL;           // Command line as received
+	size_t                  line_len;               // Length of 'line'
+	int                     fd = -1;                // Temporary file descriptor
+	int                     err = 0;                // Return code
+
+	// Rebuild the first line as received
+	line_len = strlen(cmd) + (cmd_nl?1:0);
+	if ((line = malloc(line_len + 1)) == NULL){
+		perror("malloc");
+		goto out;
+	}
+	sprintf(line, "%s%s", cmd, cmd_nl?"\n":"");
+
+	// Verify the transfer
+	if (cache_verify(conf, line, line_len, conf_fn) != 1){
+		fprintf(stderr, "%s: Configuration file does not match its hash.\n", __FUNCTION__);
+		err = -1;
+		goto out;
+	}
+
+	// Write the command line, then move the remainder in place
+	if (cache_paths(conf, &cmd_fn, &body_fn) < 0){
+		goto out;
+	}
+	if ((mkdir(MT_SYNEXEC_SLAVE_CACHEDIR, 0700) < 0) && (errno != EEXIST)){
+		perror("mkdir");
+		fprintf(stderr, "%s: Error creating cache directory '%s'.\n", __FUNCTION__, MT_SYNEXEC_SLAVE_CACHEDIR);
+		goto out;
+	}
+	if (asprintf(&tmp_fn, "%s.%d", cmd_fn, getpid()) < 0){
+		tmp_fn = NULL;
+		goto out;
+	}
+	if ((fd = open(tmp_fn, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0){
+		perror("open");
+		fprintf(stderr, "%s: Error creating cache file '%s'.\n", __FUNCTION__, tmp_fn);
+		goto out;
+	}
+	if (write(fd, line, line_len) != (ssize_t)line_len){
+		perror("write");
+		fprintf(stderr, "%s: Error writing cache file '%s'.\n", __FUNCTION__, tmp_fn);
+		(void)unlink(tmp_fn);
+		goto out;
+	}
+	if (rename(conf_fn, body_fn) < 0){
+		if (verbose > 0){
+			perror("rename");
+			fprintf(stderr, "%s: Unable to move '%s' into the cache.\n", __FUNCTION__, conf_fn);
+		}
+		(void)unlink(tmp_fn);
+		goto out;
+	}
+	*path = body_fn;
+	body_fn = NULL;
+	if (rename(tmp_fn, cmd_fn) < 0){
+		// The entry will simply never be found
+		perror("rename");
+		(void)unlink(tmp_fn);
+		goto out;
+	}
+	if (verbose > 0){
+		printf("%s: Configuration cached as '%s'.\n", __FUNCTION__, *path);
+		fflush(stdout);
+	}
+	err = 1;
+
+out:
+	// Free resources
+	if (fd >= 0){
+		close(fd);
+	}
+	if (tmp_fn){
+		free(tmp_fn);
+	}
+	if (line){
+		free(line);
+	}
+	if (cmd_fn){
+		free(cmd_fn);
+	}
+	if (body_fn){
+		free(body_fn);
+	}
+
+	// Return
+	return(err);
+}
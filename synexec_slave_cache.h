@@ -0,0 +1,41 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_slave_cache.h
+ * -----------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+#ifndef SYNEXEC_SLAVE_CACHE_H
+#define SYNEXEC_SLAVE_CACHE_H
+
+// Header files
+#include "synexec_common.h"
+
+// Global definitions
+#define MT_SYNEXEC_SLAVE_CACHEDIR       "/tmp/synexec_cache/"   // Directory to keep configuration files across sessions
+
+// Related functions
+int
+cache_lookup(synexec_conf_t *conf, char **cmd, char **path);
+
+int
+cache_store(synexec_conf_t *conf, char *cmd, char cmd_nl, char *conf_fn, char **path);
+
+#endif /* SYNEXEC_SLAVE_CACHE_H */
@@ -0,0 +1,313 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_slave_peer.c
+ * ----------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+// Header files
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "synexec_common.h"
+#include "synexec_comm.h"
+#include "synexec_slave_cache.h"
+#include "synexec_slave_peer.h"
+
+// Global variables
+extern struct in_addr           net_ifip;
+extern uint16_t                 net_port;
+
+extern int                      verbose;
+extern char                     quit;
+
+/*
+ * static void *
+ * peer_serve(void *arg);
+ * ----------------------
+ *  This thread serves one MT_SYNEXEC_MSG_FETCH request from another slave on
+ *  the socket passed in 'arg'. If the requested configuration is in the cache,
+ *  it is sent back as a MT_SYNEXEC_MSG_CONF_STREAM (the command line followed
+ *  by the remainder of the file, which is sent with sendfile()). Otherwise the
+ *  reply is a MT_SYNEXEC_MSG_CONF_MISS.
+ *
+ *  Mandatory params: arg
+ *  Optional params :
+ *
+ *  Return values:
+ *   NULL This function always return NULL
+ */
+static void *
+peer_serve(void *arg){
+	// Local variables
+	int                     peer_fd = (intptr_t)arg;// Peer connection
+	synexec_msg_t           net_msg;                // Synexec msg
+	char                    *data = NULL;           // Synexec msg data
+	synexec_fetch_t         fetch;                  // Fetch request
+	synexec_stream_t        stream;                 // Streamed configuration header
+	char                    *cmd = NULL;            // Cached command line
+	char                    *path = NULL;           // Cached remainder of the file
+	int                     fd = -1;                // Cached file descriptor
+	struct stat             sb;                     // Cached file stats
+
+	// Read the request
+	if (comm_recv(peer_fd, &net_msg, NULL, (void **)&data, NULL) <= 0){
+		goto out;
+	}
+	if ((net_msg.command != MT_SYNEXEC_MSG_FETCH) || (net_msg.datalen != sizeof(fetch))){
+		fprintf(stderr, "%s: Invalid request from peer.\n", __FUNCTION__);
+		goto out;
+	}
+	memcpy(&fetch, data, sizeof(fetch));
+
+	// Look the configuration up
+	if ((cache_lookup(&fetch.conf, &cmd, &path) <= 0) ||
+	    ((fd = open(path, O_RDONLY)) < 0) ||
+	    (fstat(fd, &sb) < 0)){
+		(void)comm_send(peer_fd, MT_SYNEXEC_MSG_CONF_MISS, NULL, NULL, 0);
+		goto out;
+	}
+
+	// Send it
+	stream.length = strlen(cmd) + sb.st_size;
+	if (verbose > 0){
+		printf("%s: Sending %" PRIu64 " bytes of configuration to a peer.\n", __FUNCTION__, stream.length);
+		fflush(stdout);
+	}
+	(void)comm_cork(peer_fd, 1);
+	if ((comm_send(peer_fd, MT_SYNEXEC_MSG_CONF_STREAM, NULL, &stream, sizeof(stream)) <= 0) ||
+	    (comm_send_raw(peer_fd, NULL, cmd, strlen(cmd)) < 0) ||
+	    (comm_send_stream(peer_fd, NULL, fd, sb.st_size) < 0)){
+		fprintf(stderr, "%s: Error sending configuration to peer.\n", __FUNCTION__);
+	}
+	(void)comm_cork(peer_fd, 0);
+
+out:
+	// Free resources
+	if (fd >= 0){
+		close(fd);
+	}
+	if (cmd){
+		free(cmd);
+	}
+	if (path){
+		free(path);
+	}
+	if (data){
+		comm_free(data);
+	}
+	comm_close(peer_fd);
+	comm_release();
+
+	// Return
+	return(NULL);
+}
+
+/*
+ * void *
+ * peer();
+ * -------
+ *  This thread accepts TCP connections from other slaves on port 'net_port'
+ *  plus MT_PEERPORT_OFFSET and serves their requests for cached configuration
+ *  files, so that configuration can be distributed along a tree of slaves
+ *  instead of entirely from the master. Each request is served by its own
+ *  thread.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  NOTES:
+ *  Failing to serve peers is not fatal, the master sends the configuration
+ *  itself to slaves that could not fetch it.
+ *  Return values:
+ *   0 This function always return NULL
+ */
+void *
+peer(){
+	// Local variables
+	int                     peer_fd = -1;           // Peer TCP socket
+	struct sockaddr_in      peer_addr;              // Peer sockaddr
+	struct pollfd           pfd;                    // Poll descriptor
+	pthread_attr_t          attr;                   // Serving thread attributes
+	pthread_t               tid;                    // Serving thread id
+
+	int                     i;                      // Temporary integer
+
+	// Create TCP socket
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if ((peer_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0){
+		perror("socket");
+		fprintf(stderr, "%s: Error creating peer TCP socket.\n", __FUNCTION__);
+		goto out;
+	}
+	i = 1; // SO_REUSEADDR = true
+	if (setsockopt(peer_fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&i, sizeof(int)) < 0){
+		perror("setsockopt");
+		fprintf(stderr, "%s: Error setting SO_REUSEADDR to peer TCP socket.\n", __FUNCTION__);
+		goto out;
+	}
+	memset(&peer_addr, 0, sizeof(peer_addr));
+	peer_addr.sin_family = AF_INET;
+	memcpy(&peer_addr.sin_addr, &net_ifip, sizeof(peer_addr.sin_addr));
+	peer_addr.sin_port = htons(net_port + MT_PEERPORT_OFFSET);
+	if (bind(peer_fd, (struct sockaddr *)&peer_addr, sizeof(peer_addr)) < 0){
+		perror("bind");
+		fprintf(stderr, "%s: Error binding peer TCP socket, not serving peers.\n", __FUNCTION__);
+		goto out;
+	}
+	listen(peer_fd, SOMAXCONN);
+
+	// Accept requests
+	while(!quit){
+		pfd.fd = peer_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		i = poll(&pfd, 1, SYNEXEC_SLAVE_PEER_LOOPTIMEO_SEC * 1000);
+		if (i <= 0){
+			continue;
+		}
+		if ((i = accept4(peer_fd, NULL, NULL, SOCK_CLOEXEC)) < 0){
+			continue;
+		}
+		if (pthread_create(&tid, &attr, &peer_serve, (void *)(intptr_t)i) != 0){
+			perror("pthread_create");
+			close(i);
+		}
+	}
+
+out:
+	if (peer_fd >= 0){
+		close(peer_fd);
+	}
+	pthread_attr_destroy(&attr);
+
+	// Return
+	return NULL;
+}
+
+/*
+ * int
+ * peer_fetch(synexec_fetch_t *fetch, synexec_msg_t *net_msg, char **data);
+ * ------------------------------------------------------------------------
+ *  This function connects to the peer described in 'fetch' and requests the
+ *  configuration file in 'fetch->conf'. The reply header is stored in
+ *  'net_msg' and its data in '*data' (see comm_recv()). The contents of the
+ *  file follow on the returned socket, which must be closed after use. As this
+ *  holds up the worker thread, connecting is given up on after
+ *  SYNEXEC_SLAVE_PEER_REPLYTIMEO_SEC, as is waiting for the reply.
+ *
+ *  Mandatory params: fetch, net_msg, data
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error (or peer does not have the configuration)
+ *    n Connected socket, positioned after a MT_SYNEXEC_MSG_CONF_STREAM
+ */
+int
+peer_fetch(synexec_fetch_t *fetch, synexec_msg_t *net_msg, char **data){
+	// Local variables
+	int                     sock = -1;              // Peer socket
+	struct sockaddr_in      peer_addr;              // Peer sockaddr
+	struct timeval          timeout;                // Reply timeout
+	struct pollfd           pfd;                    // Connection in progress
+	socklen_t               len;                    // Length of SO_ERROR
+	int                     i;                      // Temporary integer
+
+	// Connect to the peer
+	memset(&peer_addr, 0, sizeof(peer_addr));
+	peer_addr.sin_family = AF_INET;
+	peer_addr.sin_addr.s_addr = fetch->addr;
+	peer_addr.sin_port = fetch->port;
+	if (verbose > 0){
+		printf("%s: Fetching configuration from peer '%s:%hu'.\n", __FUNCTION__,
+		       inet_ntoa(peer_addr.sin_addr), ntohs(peer_addr.sin_port));
+		fflush(stdout);
+	}
+	if ((sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0){
+		perror("socket");
+		goto err;
+	}
+	if ((connect(sock, (struct sockaddr *)&peer_addr, sizeof(peer_addr)) < 0) && (errno != EINPROGRESS)){
+		perror("connect");
+		fprintf(stderr, "%s: Error connecting to peer.\n", __FUNCTION__);
+		goto err;
+	}
+
+	// Wait for the connection, but not for as long as the kernel would
+	pfd.fd = sock;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	while (((i = poll(&pfd, 1, SYNEXEC_SLAVE_PEER_REPLYTIMEO_SEC * 1000)) < 0) && (errno == EINTR));
+	if (i <= 0){
+		if (i < 0){
+			perror("poll");
+		}
+		fprintf(stderr, "%s: Timed out connecting to peer.\n", __FUNCTION__);
+		goto err;
+	}
+	len = sizeof(i);
+	if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &i, &len) < 0){
+		perror("getsockopt");
+		goto err;
+	}
+	if (i != 0){
+		fprintf(stderr, "connect: %s\n", strerror(i));
+		fprintf(stderr, "%s: Error connecting to peer.\n", __FUNCTION__);
+		goto err;
+	}
+
+	// Request the configuration
+	if (comm_send(sock, MT_SYNEXEC_MSG_FETCH, NULL, fetch, sizeof(*fetch)) <= 0){
+		goto err;
+	}
+	timeout.tv_sec = SYNEXEC_SLAVE_PEER_REPLYTIMEO_SEC;
+	timeout.tv_usec = 0;
+	if (comm_recv(sock, net_msg, &timeout, (void **)data, NULL) <= 0){
+		goto err;
+	}
+	if (net_msg->command != MT_SYNEXEC_MSG_CONF_STREAM){
+		fprintf(stderr, "%s: Peer does not have the configuration.\n", __FUNCTION__);
+		goto err;
+	}
+
+out:
+	// Return
+	return(sock);
+
+err:
+	if (sock >= 0){
+		comm_close(sock);
+		sock = -1;
+	}
+	goto out;
+}
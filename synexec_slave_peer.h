@@ -0,0 +1,43 @@
+/*
+ * ------------------------------------
+ *  synexec - Synchronised Executioner
+ * ------------------------------------
+ *  synexec_slave_peer.h
+ * ----------------------
+ *  Copyright 2014 (c) Citrix
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version only.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read the README file for the changelog and information on how to
+ * compile and use this program.
+ */
+
+#ifndef SYNEXEC_SLAVE_PEER_H
+#define SYNEXEC_SLAVE_PEER_H
+
+// Header files
+#include "synexec_common.h"
+
+// Global definitions
+#define SYNEXEC_SLAVE_PEER_LOOPTIMEO_SEC        1       // Main loop poll timeout (secs)
+#define SYNEXEC_SLAVE_PEER_REPLYTIMEO_SEC       10      // Time for a peer to accept the connection or look up a configuration (secs)
+#define SYNEXEC_SLAVE_PEER_STREAMTIMEO_SEC      1       // Longest stall while a peer streams a configuration (secs)
+
+// Related functions
+void *
+peer();
+
+int
+peer_fetch(synexec_fetch_t *fetch, synexec_msg_t *net_msg, char **data);
+
+#endif /* SYNEXEC_SLAVE_PEER_H */
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <ctype.h>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -35,14 +36,25 @@
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <sys/select.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include "synexec_common.h"
 #include "synexec_comm.h"
 #include "synexec_slave_worker.h"
+#include "synexec_slave_cache.h"
+#include "synexec_slave_peer.h"
+#include "synexec_slave_barrier.h"
 
 // Global variables
 extern struct sockaddr_in       master_addr;
@@ -56,26 +68,787 @@ extern uint16_t                 net_port;
 extern uint32_t                 session;
 extern int                      verbose;
 extern char                     quit;
+extern char                     stream_output;
+extern int                      ring_output;
+extern char                     low_jitter;
 
 static int                      worker_pid = 0;
-static struct timeval           worker_time[3];         // execution: 0-started, 1-finished, 2-zero for ref
+static int                      worker_pidfd = -1;      // Pidfd of the worker (-1 if reaped by sigchld_h)
+static int                      worker_go = -1;         // Pipe to release the armed worker
+static int                      worker_report = -1;     // Pipe to read the worker exec time and errno
+static struct timespec          worker_time[2];         // execution: 0-started, 1-finished (MT_SYNEXEC_CLOCK_WALL)
+static struct timespec          worker_mono[2];         // execution: 0-started, 1-finished (MT_SYNEXEC_CLOCK_MONO)
+static int                      worker_status;          // Wait status of the finished worker
+static struct rusage            worker_rusage;          // Resource usage of the finished worker
+static int                      worker_out = -1;        // Pipe to read the worker output from (stream_output, ring_output)
+static char                     worker_out_buf[MT_SYNEXEC_SLAVE_OUTPUT_BATCH];// Output not yet sent to the master
+static int                      worker_out_len = 0;     // Bytes held in worker_out_buf
+static struct timespec          worker_out_time;        // Time the oldest byte held was read (MT_SYNEXEC_CLOCK_MONO)
+static char                     *worker_ring = NULL;    // Last output of the worker (ring_output)
+static size_t                   worker_ring_size = 0;   // Size of worker_ring
+static uint64_t                 worker_ring_len = 0;    // Bytes of output written to worker_ring since the start
+static int                      worker_inst = -1;       // Pipe to read the instance reports from
+static int                      worker_instances = 1;   // Instances of the released worker
+static int                      worker_supervised = 0;  // The released worker supervises its instances
+static int                      worker_fifo = 0;        // Worker thread runs SCHED_FIFO (low_jitter), -1 if not permitted
+static int                      worker_spin = 0;        // Spin up to a scheduled start (low_jitter)
 
 /*
  * void
  * sigchld_h();
  * ------------
  *  This is the handler for SIGCHLD, which resets the worker_pid global var.
+ *  The finish time, wait status and resource usage are only recorded for a
+ *  worker that was started, so an armed worker that is discarded does not get
+ *  reported to the master.
+ *  Workers with a pidfd are reaped by worker_reap() instead.
  */
 void
 sigchld_h(){
+	// Local variables
+	int                     pid;                    // Reaped child
+	int                     status;                 // Wait status of the child
+	struct rusage           rusage;                 // Resource usage of the child
+
+	// Leave the worker to handle_conn() if it is watching its pidfd
+	if (worker_pidfd >= 0){
+		return;
+	}
+
+	// Capture child exit status and resource usage
+	while ((pid = wait4(-1, &status, WNOHANG, &rusage)) > 0){
+		if (pid != worker_pid){
+			continue;
+		}
+
+		// Mark worker as finished
+		worker_pid = 0;
+
+		// Get time worker finished
+		if (worker_time[0].tv_sec || worker_time[0].tv_nsec){
+			worker_status = status;
+			worker_rusage = rusage;
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &worker_mono[1]);
+			clock_gettime(MT_SYNEXEC_CLOCK_WALL, &worker_time[1]);
+		}
+	}
+}
+
+/*
+ * static void
+ * worker_reap(int options);
+ * -------------------------
+ *  This function reaps the worker watched through worker_pidfd, passing
+ *  'options' to wait4(). As in sigchld_h(), the finish time, wait status and
+ *  resource usage are only recorded for a worker that was started. The pidfd
+ *  is closed once the worker is gone.
+ *
+ *  Mandatory params:
+ *  Optional params : options
+ *
+ *  Return values:
+ *   None
+ */
+static void
+worker_reap(int options){
+	// Local variables
+	int                     pid;                    // Reaped child
+	int                     status;                 // Wait status of the worker
+	struct rusage           rusage;                 // Resource usage of the worker
+
+	// Only workers with a pidfd are reaped here
+	if ((worker_pidfd < 0) || (worker_pid == 0)){
+		return;
+	}
+
+	// Reap worker
+	while (((pid = wait4(worker_pid, &status, options, &rusage)) < 0) && (errno == EINTR));
+	if (pid == 0){
+		return;
+	}
+	if ((pid < 0) && (errno != ECHILD)){
+		perror("wait4");
+		fprintf(stderr, "%s: Error reaping worker %d.\n", __FUNCTION__, worker_pid);
+		return;
+	}
+
+	// Get time worker finished
+	if ((pid > 0) && (worker_time[0].tv_sec || worker_time[0].tv_nsec)){
+		worker_status = status;
+		worker_rusage = rusage;
+		clock_gettime(MT_SYNEXEC_CLOCK_MONO, &worker_mono[1]);
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &worker_time[1]);
+	}
+
 	// Mark worker as finished
+	close(worker_pidfd);
+	worker_pidfd = -1;
 	worker_pid = 0;
+}
 
-	// Get time worker finished
-	gettimeofday(&worker_time[1], NULL);
+/*
+ * static void
+ * worker_sched(int fifo);
+ * -----------------------
+ *  This function moves the calling thread to SCHED_FIFO (at
+ *  MT_SYNEXEC_SLAVE_RT_PRIO) if 'fifo' is set, or back to SCHED_OTHER, when
+ *  the slave runs in low jitter mode. The armed worker is raised along with
+ *  it, and drops back by itself once released. The worker thread is only
+ *  raised shortly before a start (see worker_wait_start()). If the slave is
+ *  not permitted to, it carries on at normal priority.
+ *
+ *  Mandatory params:
+ *  Optional params : fifo
+ *
+ *  Return values:
+ *   None
+ */
+static void
+worker_sched(int fifo){
+	// Local variables
+	struct sched_param      param;                  // Scheduling priority
+	int                     err;                    // Return value of pthread_setschedparam()
+
+	// Only change policy when needed
+	if (!low_jitter || (worker_fifo < 0) || (worker_fifo == fifo)){
+		return;
+	}
+
+	// Set policy
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = fifo?MT_SYNEXEC_SLAVE_RT_PRIO:0;
+	if ((err = pthread_setschedparam(pthread_self(), fifo?SCHED_FIFO:SCHED_OTHER, &param)) != 0){
+		fprintf(stderr, "%s: pthread_setschedparam: %s. Carrying on at normal priority.\n", __FUNCTION__, strerror(err));
+		worker_fifo = -1;
+		return;
+	}
+	worker_fifo = fifo;
+
+	// Raise the armed worker too, so it is woken up promptly on release
+	if (fifo && worker_pid && (worker_go >= 0) && (sched_setscheduler(worker_pid, SCHED_FIFO, &param) < 0)){
+		perror("sched_setscheduler");
+		fprintf(stderr, "%s: Error raising the armed worker.\n", __FUNCTION__);
+	}
+}
+
+/*
+ * static void
+ * worker_disarm();
+ * ----------------
+ *  This function discards the armed worker, if any. Closing the go pipe causes
+ *  the worker to exit without executing anything, so it is reaped right away.
+ *  The worker thread drops back to normal priority (see worker_sched()).
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+worker_disarm(){
+	if (worker_go >= 0){
+		close(worker_go);
+		worker_go = -1;
+		worker_reap(0);
+	}
+	if (worker_report >= 0){
+		close(worker_report);
+		worker_report = -1;
+	}
+	worker_sched(0);
+}
+
+/*
+ * static int
+ * worker_cpus(int *cpus);
+ * -----------------------
+ *  This function lists the CPUs the slave may run on into 'cpus' (at least
+ *  CPU_SETSIZE entries), which instances are pinned to in turn.
+ *
+ *  Mandatory params:
+ *  Optional params : cpus
+ *
+ *  Return values:
+ *   Number of CPUs (at least one)
+ */
+static int
+worker_cpus(int *cpus){
+	// Local variables
+	cpu_set_t               set;                    // CPUs the slave may run on
+	int                     n = 0;                  // CPUs found
+	int                     i;                      // Temporary integer
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0){
+		perror("sched_getaffinity");
+		if (cpus){
+			cpus[0] = 0;
+		}
+		return(1);
+	}
+	for (i=0; i<CPU_SETSIZE; i++){
+		if (CPU_ISSET(i, &set)){
+			if (cpus){
+				cpus[n] = i;
+			}
+			n++;
+		}
+	}
+	return(n?n:1);
+}
+
+/*
+ * static void
+ * worker_supervise(char *argp, char **argv, synexec_instances_t *inst,
+ *                  int inst_fd);
+ * --------------------------------------------------------------------
+ *  This function runs in the released worker when the task has several
+ *  instances or they are pinned. It forks 'inst->count' instances, each one
+ *  finding its number in MT_SYNEXEC_SLAVE_INSTANCE_ENV and executing 'argp'
+ *  with 'argv', pinned to its own CPU if 'inst->pin' is set. It then reaps
+ *  them, writing a synexec_instance_t for each to 'inst_fd' as it finishes
+ *  (so the slave can tell how many are still running), and exits with
+ *  the status of the first instance that failed (128 plus the signal number
+ *  if it was killed), or zero. Signals are blocked in the worker, so signals
+ *  sent to the process group of the task only reach the instances.
+ *
+ *  Mandatory params: argp, argv, inst, inst_fd
+ *  Optional params :
+ *
+ *  Return values:
+ *   This function does not return
+ */
+static void
+worker_supervise(char *argp, char **argv, synexec_instances_t *inst, int inst_fd){
+	// Local variables
+	synexec_instance_t      report[MT_SYNEXEC_SLAVE_INSTANCES_MAX];// Instance reports
+	struct timespec         mono[MT_SYNEXEC_SLAVE_INSTANCES_MAX];// Instance start times (MT_SYNEXEC_CLOCK_MONO)
+	int                     pids[MT_SYNEXEC_SLAVE_INSTANCES_MAX];// Instance processes
+	int                     cpus[CPU_SETSIZE];      // CPUs to pin instances to
+	int                     ncpus;                  // Number of CPUs in 'cpus'
+	cpu_set_t               set;                    // CPU of an instance
+	sigset_t                mask, omask;            // Signals blocked in the worker
+	struct timespec         now;                    // Current time
+	struct rusage           rusage;                 // Resource usage of an instance
+	char                    index[16];              // Instance number
+	int                     status, failed = 0;     // Wait status of an instance, and of the first that failed
+	int                     running = 0;            // Instances left to reap
+	int                     pid;                    // Temporary pid
+	int                     i;                      // Temporary integer
+
+	sigfillset(&mask);
+	sigprocmask(SIG_BLOCK, &mask, &omask);
+	ncpus = worker_cpus(cpus);
+
+	// Start the instances
+	memset(report, 0, sizeof(report));
+	for (i=0; i<inst->count; i++){
+		report[i].index = i;
+		report[i].cpu = inst->pin?cpus[i % ncpus]:-1;
+		clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono[i]);
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+		ts_to_net(&now, &report[i].time[0]);
+		if ((pids[i] = fork()) == 0){
+			if (inst->pin){
+				CPU_ZERO(&set);
+				CPU_SET(report[i].cpu, &set);
+				if (sched_setaffinity(0, sizeof(set), &set) < 0){
+					perror("sched_setaffinity");
+				}
+			}
+			snprintf(index, sizeof(index), "%d", i);
+			setenv(MT_SYNEXEC_SLAVE_INSTANCE_ENV, index, 1);
+			sigprocmask(SIG_SETMASK, &omask, NULL);
+			execv(argp, argv);
+			perror("execv");
+			_exit(127);
+		}
+		if (pids[i] < 0){
+			perror("fork");
+			report[i].status = 127 << 8;
+			failed = failed?failed:report[i].status;
+			if (write(inst_fd, &report[i], sizeof(report[i])) < 0){
+				perror("write");
+			}
+			continue;
+		}
+		running++;
+	}
+
+	// Reap them as they finish
+	while (running > 0){
+		if ((pid = wait4(-1, &status, 0, &rusage)) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			perror("wait4");
+			break;
+		}
+		for (i=0; (i<inst->count) && (pids[i] != pid); i++);
+		if (i == inst->count){
+			continue;
+		}
+		clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+		report[i].elapsed = ts_diff_nsec(&now, &mono[i]);
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+		ts_to_net(&now, &report[i].time[1]);
+		report[i].status = status;
+		ru_to_net(&rusage, &report[i].rusage);
+		failed = failed?failed:status;
+		running--;
+		if (write(inst_fd, &report[i], sizeof(report[i])) < 0){
+			perror("write");
+		}
+	}
+
+	// Exit
+	if (WIFSIGNALED(failed)){
+		_exit(128 + WTERMSIG(failed));
+	}
+	_exit(WEXITSTATUS(failed));
+}
+
+/*
+ * static int
+ * worker_arm(int worker_fd, char *argp, char **argv);
+ * ---------------------------------------------------
+ *  This function forks the worker ahead of execution. The child redirects its
+ *  output to MT_SYNEXEC_SLAVE_OUTPUT (or to the output pipe, if streaming it
+ *  to the master) and blocks reading the go pipe. Once
+ *  released by worker_start(), it reports the time it is about to call
+ *  execv() over the report pipe and executes 'argp' with 'argv'. Should the
+ *  execv() fail, its errno is sent over the report pipe as well. The report
+ *  pipe is closed on exec, so the parent can tell both cases apart. If the
+ *  task has several instances, the worker closes the report pipe and becomes
+ *  their supervisor instead (see worker_supervise()).
+ *
+ *  Mandatory params: worker_fd, argp, argv
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+worker_arm(int worker_fd, char *argp, char **argv){
+	// Local variables
+	int                     go_fds[2] = {-1, -1};   // Go pipe
+	int                     report_fds[2] = {-1, -1};// Report pipe
+	int                     out_fds[2] = {-1, -1};  // Output pipe
+	int                     inst_fds[2] = {-1, -1}; // Instance report pipe
+	synexec_instances_t     inst;                   // Instances to run
+	int                     exec_fd = -1;           // Redirected output of forked worker
+	struct timespec         now;                    // Time before execv()
+	synexec_time_t          net_time;               // Time before execv() (marshalled)
+	struct sched_param      param;                  // Scheduling priority of the released worker
+
+	int                     pid;                    // Forked worker
+	int                     err = 0;                // Return value
+
+	// Discard previously armed worker, and the output pipe of the previous one
+	worker_disarm();
+	if (worker_out >= 0){
+		close(worker_out);
+		worker_out = -1;
+	}
+	if (worker_inst >= 0){
+		close(worker_inst);
+		worker_inst = -1;
+	}
+
+	// Create pipes
+	if (pipe(go_fds) < 0){
+		perror("pipe");
+		fprintf(stderr, "%s: Error creating go pipe.\n", __FUNCTION__);
+		goto err;
+	}
+	if (pipe2(report_fds, O_CLOEXEC) < 0){
+		perror("pipe2");
+		fprintf(stderr, "%s: Error creating report pipe.\n", __FUNCTION__);
+		goto err;
+	}
+	if (pipe2(inst_fds, O_CLOEXEC) < 0){
+		perror("pipe2");
+		fprintf(stderr, "%s: Error creating instance report pipe.\n", __FUNCTION__);
+		goto err;
+	}
+	if ((stream_output || worker_ring) && (pipe2(out_fds, O_CLOEXEC) < 0)){
+		perror("pipe2");
+		fprintf(stderr, "%s: Error creating output pipe.\n", __FUNCTION__);
+		goto err;
+	}
+
+	pid = fork();
+	if (pid < 0){
+		// Fork failed
+		perror("fork");
+		fprintf(stderr, "%s: Error forking worker.\n", __FUNCTION__);
+		goto err;
+	}else
+	if (pid == 0){
+		// Child, leading its own process group so signals reach the whole task
+		(void)setpgid(0, 0);
+		close(worker_fd);
+		close(go_fds[1]);
+		close(report_fds[0]);
+		close(inst_fds[0]);
+		if (out_fds[1] >= 0){
+			close(out_fds[0]);
+			exec_fd = out_fds[1];
+		}else
+		if ((exec_fd = creat(MT_SYNEXEC_SLAVE_OUTPUT, S_IRUSR|S_IWUSR)) < 0){
+			perror("creat");
+			_exit(1);
+		}
+		close(fileno(stdout));
+		close(fileno(stderr));
+		if ((dup2(exec_fd, fileno(stdout)) < 0) ||
+		    (dup2(exec_fd, fileno(stderr)) < 0)){
+			perror("dup2");
+			_exit(1);
+		}
+		close(exec_fd);
+
+		// Wait to be released, learning how many instances to run
+		if (read(go_fds[0], &inst, sizeof(inst)) != sizeof(inst)){
+			_exit(0);
+		}
+		close(go_fds[0]);
+
+		// Drop the real-time priority it may have been raised to (see worker_sched())
+		if (low_jitter){
+			memset(&param, 0, sizeof(param));
+			(void)sched_setscheduler(0, SCHED_OTHER, &param);
+		}
+
+		// Report and go
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+		ts_to_net(&now, &net_time);
+		if ((inst.count > 1) || inst.pin){
+			if (write(report_fds[1], &net_time, sizeof(net_time)) == sizeof(net_time)){
+				close(report_fds[1]);
+				worker_supervise(argp, argv, &inst, inst_fds[1]);
+			}
+			_exit(1);
+		}
+		if (write(report_fds[1], &net_time, sizeof(net_time)) == sizeof(net_time)){
+			execv(argp, argv);
+			err = errno;
+			perror("execv");
+			if (write(report_fds[1], &err, sizeof(err)) < 0){
+				perror("write");
+			}
+		}
+		_exit(1);
+	}
+
+	// Parent
+	(void)setpgid(pid, pid);
+	worker_pid = pid;
+#ifdef SYS_pidfd_open
+	// Watch the worker through a pidfd, falling back to sigchld_h() if unsupported
+	if ((worker_pidfd = syscall(SYS_pidfd_open, pid, 0)) < 0){
+		if (verbose > 0){
+			printf("%s: pidfd_open: %s. Polling for worker completion instead.\n", __FUNCTION__, strerror(errno));
+		}
+		worker_pidfd = -1;
+	}
+#endif
+	worker_go = go_fds[1];
+	worker_report = report_fds[0];
+	worker_inst = inst_fds[0];
+	close(go_fds[0]);
+	close(report_fds[1]);
+	close(inst_fds[1]);
+	if (out_fds[0] >= 0){
+		// Read the output without blocking, so it is collected from the event loop
+		worker_out = out_fds[0];
+		worker_out_len = 0;
+		close(out_fds[1]);
+		(void)fcntl(worker_out, F_SETFL, fcntl(worker_out, F_GETFL) | O_NONBLOCK);
+	}
+
+out:
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	if (go_fds[0] >= 0){
+		close(go_fds[0]);
+		close(go_fds[1]);
+	}
+	if (report_fds[0] >= 0){
+		close(report_fds[0]);
+		close(report_fds[1]);
+	}
+	if (out_fds[0] >= 0){
+		close(out_fds[0]);
+		close(out_fds[1]);
+	}
+	if (inst_fds[0] >= 0){
+		close(inst_fds[0]);
+		close(inst_fds[1]);
+	}
+	goto out;
+}
+
+/*
+ * static int
+ * worker_start(struct timespec *exec_time, synexec_instances_t *inst);
+ * --------------------------------------------------------------------
+ *  This function releases the armed worker and waits for it to report back.
+ *  'exec_time' is set to the time the worker called execv(). If 'inst' asks
+ *  for several instances (zero for one per CPU, up to
+ *  MT_SYNEXEC_SLAVE_INSTANCES_MAX) or for pinning, the worker runs them
+ *  under its supervision (see worker_supervise()).
+ *
+ *  Mandatory params: exec_time
+ *  Optional params : inst
+ *
+ *  Return values:
+ *   -1 Error (including execv() failing in the worker)
+ *    0 Success
+ */
+static int
+worker_start(struct timespec *exec_time, synexec_instances_t *inst){
+	// Local variables
+	synexec_instances_t     go;                     // Instances the worker runs
+	synexec_time_t          net_time;               // Time before execv() (marshalled)
+	int                     exec_errno;             // execv() errno
+	int                     err = 0;                // Return value
+
+	// Work out the instances
+	memset(&go, 0, sizeof(go));
+	go.count = inst?inst->count:1;
+	go.pin = inst?inst->pin:0;
+	if (go.count <= 0){
+		go.count = worker_cpus(NULL);
+	}
+	if (go.count > MT_SYNEXEC_SLAVE_INSTANCES_MAX){
+		fprintf(stderr, "%s: Running %d instances instead of %d.\n", __FUNCTION__, MT_SYNEXEC_SLAVE_INSTANCES_MAX, go.count);
+		go.count = MT_SYNEXEC_SLAVE_INSTANCES_MAX;
+	}
+	worker_instances = go.count;
+	worker_supervised = (go.count > 1) || go.pin;
+
+	// Release the worker
+	if (write(worker_go, &go, sizeof(go)) != sizeof(go)){
+		perror("write");
+		fprintf(stderr, "%s: Error releasing worker.\n", __FUNCTION__);
+		goto err;
+	}
+	close(worker_go);
+	worker_go = -1;
+	worker_sched(0);
+
+	// Fetch the time before execv(), then wait for it to complete
+	if (read(worker_report, &net_time, sizeof(net_time)) != sizeof(net_time)){
+		fprintf(stderr, "%s: Worker did not report its exec time.\n", __FUNCTION__);
+		goto err;
+	}
+	net_to_ts(&net_time, exec_time);
+	if (read(worker_report, &exec_errno, sizeof(exec_errno)) != 0){
+		fprintf(stderr, "%s: Worker failed to execute command.\n", __FUNCTION__);
+		goto err;
+	}
 
-	// Capture (well, ignore) child exit status
-	while (waitpid(-1, NULL, WNOHANG) > 0);
+out:
+	// Return
+	worker_disarm();
+	return(err);
+
+err:
+	err = -1;
+	goto out;
+}
+
+/*
+ * static int
+ * proc_sample(int pid, unsigned long *utime, unsigned long *stime, long *rss);
+ * ----------------------------------------------------------------------------
+ *  This function adds the CPU time (including the children it has already
+ *  reaped) and resident set size of process 'pid' to 'utime', 'stime' (in
+ *  ticks) and 'rss' (in pages). They are read from /proc/<pid>/stat, which is
+ *  cheap enough to read at every heartbeat.
+ *
+ *  Mandatory params: pid, utime, stime, rss
+ *  Optional params :
+ *
+ *  Return values:
+ *   0 Process could not be sampled
+ *   1 Process sampled
+ */
+static int
+proc_sample(int pid, unsigned long *utime, unsigned long *stime, long *rss){
+	// Local variables
+	char                    buf[1024];              // Contents of /proc/<pid>/stat
+	char                    *ptr;                   // End of the command name
+	unsigned long           u, s;                   // CPU time of the process (ticks)
+	long                    cu, cs;                 // CPU time of its reaped children (ticks)
+	long                    r;                      // Resident set size (pages)
+	int                     fd;                     // /proc/<pid>/stat descriptor
+	ssize_t                 i;                      // Temporary integer
+
+	// The command name may hold spaces, so parse from its end
+	snprintf(buf, sizeof(buf), "/proc/%d/stat", pid);
+	if ((fd = open(buf, O_RDONLY)) < 0){
+		return(0);
+	}
+	i = read(fd, buf, sizeof(buf)-1);
+	close(fd);
+	buf[(i > 0)?i:0] = 0;
+	if (((ptr = strrchr(buf, ')')) == NULL) ||
+	    (sscanf(ptr+1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %ld %ld %*d %*d %*d %*d %*u %*u %ld",
+	            &u, &s, &cu, &cs, &r) != 5)){
+		return(0);
+	}
+	*utime += u + cu;
+	*stime += s + cs;
+	*rss += r;
+	return(1);
+}
+
+/*
+ * static int
+ * worker_beat(int worker_fd);
+ * ---------------------------
+ *  This function sends a MT_SYNEXEC_MSG_RUNNING to the master with how long
+ *  the worker has been running and its CPU time and resident set size so far
+ *  (see proc_sample()). The CPU time includes the children the worker has
+ *  already reaped. A worker supervising several instances is sampled
+ *  together with the instances still running, listed in
+ *  /proc/<pid>/task/<pid>/children. If the worker cannot be sampled, the
+ *  counters are left at zero.
+ *
+ *  Mandatory params: worker_fd
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    1 Progress sent
+ */
+static int
+worker_beat(int worker_fd){
+	// Local variables
+	synexec_running_t       running;                // Progress report
+	struct timespec         now;                    // Current time
+	char                    buf[4096];              // Children of the worker
+	char                    *ptr, *end;             // Temporary pointers
+	unsigned long           utime = 0, stime = 0;   // CPU time of the task (ticks)
+	long                    rss = 0;                // Resident set size (pages)
+	long                    hz;                     // Ticks per second
+	int                     fd;                     // /proc/<pid>/task/<pid>/children descriptor
+	ssize_t                 i;                      // Temporary integer
+
+	// Time elapsed so far
+	memset(&running, 0, sizeof(running));
+	clock_gettime(MT_SYNEXEC_CLOCK_MONO, &now);
+	running.elapsed = ts_diff_nsec(&now, &worker_mono[0]);
+
+	// Sample the worker, and its instances
+	if (proc_sample(worker_pid, &utime, &stime, &rss)){
+		if (worker_supervised){
+			snprintf(buf, sizeof(buf), "/proc/%d/task/%d/children", worker_pid, worker_pid);
+			if ((fd = open(buf, O_RDONLY)) >= 0){
+				i = read(fd, buf, sizeof(buf)-1);
+				close(fd);
+				buf[(i > 0)?i:0] = 0;
+				for (ptr = buf; (i = strtol(ptr, &end, 10)) > 0; ptr = end){
+					(void)proc_sample(i, &utime, &stime, &rss);
+				}
+			}
+		}
+		hz = sysconf(_SC_CLK_TCK);
+		running.utime.tv_sec  = utime / hz;
+		running.utime.tv_nsec = (utime % hz) * (1000000000 / hz);
+		running.stime.tv_sec  = stime / hz;
+		running.stime.tv_nsec = (stime % hz) * (1000000000 / hz);
+		running.rss = rss * (sysconf(_SC_PAGESIZE) / 1024);
+	}
+
+	// Report it
+	if (verbose > 1){
+		printf("%s: Sending RUNNING to master...\n", __FUNCTION__);
+		fflush(stdout);
+	}
+	return((comm_send(worker_fd, MT_SYNEXEC_MSG_RUNNING, NULL, &running, sizeof(running)) > 0)?1:-1);
+}
+
+/*
+ * static int
+ * worker_instances_left();
+ * ------------------------
+ *  This function tells how many instances of the released worker are still
+ *  running, from the reports the worker wrote for those that finished (see
+ *  worker_supervise()), which are left in the pipe until it is reaped.
+ *
+ *  Mandatory params:
+ *  Optional params :
+ *
+ *  Return values:
+ *   Number of instances still running
+ */
+static int
+worker_instances_left(){
+	// Local variables
+	int                     len;                    // Bytes of reports in the pipe
+
+	if (!worker_supervised || (worker_inst < 0) || (ioctl(worker_inst, FIONREAD, &len) < 0)){
+		return(worker_instances);
+	}
+	return(worker_instances - (len / (int)sizeof(synexec_instance_t)));
+}
+
+/*
+ * static int
+ * worker_instances_report(int worker_fd);
+ * ---------------------------------------
+ *  This function relays the reports of the instances supervised by the
+ *  finished worker to the master, one MT_SYNEXEC_MSG_INSTANCE each, in the
+ *  order of the instances rather than the order they finished in. The
+ *  instance report pipe is closed afterwards.
+ *
+ *  Mandatory params: worker_fd
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+worker_instances_report(int worker_fd){
+	// Local variables
+	synexec_instance_t      report[MT_SYNEXEC_SLAVE_INSTANCES_MAX];// Instance reports
+	char                    seen[MT_SYNEXEC_SLAVE_INSTANCES_MAX];// Instances reported
+	synexec_instance_t      aux;                    // Instance report read
+	int                     i;                      // Temporary integer
+	int                     err = 0;                // Return value
+
+	// The worker has been reaped, so the reports are all in the pipe
+	memset(seen, 0, sizeof(seen));
+	while (worker_inst >= 0){
+		if (read(worker_inst, &aux, sizeof(aux)) != sizeof(aux)){
+			close(worker_inst);
+			worker_inst = -1;
+			break;
+		}
+		if ((aux.index >= 0) && (aux.index < MT_SYNEXEC_SLAVE_INSTANCES_MAX)){
+			report[aux.index] = aux;
+			seen[aux.index] = 1;
+		}
+	}
+
+	// Relay them in order
+	for (i=0; i<MT_SYNEXEC_SLAVE_INSTANCES_MAX; i++){
+		if (seen[i] && (comm_send(worker_fd, MT_SYNEXEC_MSG_INSTANCE, NULL, &report[i], sizeof(report[i])) < 0)){
+			err = -1;
+			break;
+		}
+	}
+
+	// Return
+	return(err);
 }
 
 /*
@@ -177,43 +950,339 @@ make_argv(char *data, char *conf_fn, char **argp, char ***argv){
 	if (!*++ptr)                              goto err;   // Needs to have something after last '/'
 	if (!((*argv)[0] = strdup(ptr)))          goto err;   // Copy basename to *argv[0]
 
-	// Fill remaining entries
-	for (i=1; i<argc-1; i++){
-		if (!(ptr = strtok(NULL, " \f\n\r\t\v"))){
-			goto err;
+	// Fill remaining entries
+	for (i=1; i<argc-1; i++){
+		if (!(ptr = strtok(NULL, " \f\n\r\t\v"))){
+			goto err;
+		}
+		if (!strcmp(ptr, MT_SYNEXEC_CONF_TOKEN)){
+			if (!((*argv)[i] = strdup(conf_fn))){
+				goto err;
+			}
+		}else{
+			if (!((*argv)[i] = strdup(ptr))){
+				goto err;
+			}
+		}
+	}
+	
+	// Return number of arguments (including the terminating NULL)
+	err = argc;
+
+out:
+	// Return
+	return(err);
+
+err:
+	err = -1;
+	free_argvp(argp, argv);
+	goto out;
+}
+
+/*
+ * static void
+ * wait_until(struct timespec *deadline);
+ * --------------------------------------
+ *  This function blocks until the local clock (MT_SYNEXEC_CLOCK_WALL) reaches
+ *  'deadline'. It sleeps until MT_SYNEXEC_SLAVE_SPIN_NSEC before the deadline
+ *  and then busy-waits on the clock, so the wakeup is not subject to scheduler
+ *  latency. The sleep is against the absolute deadline, so it is not skewed
+ *  by how long it took to get here. It returns immediately if 'deadline' is
+ *  already in the past.
+ *
+ *  Mandatory params: deadline
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+wait_until(struct timespec *deadline){
+	// Local variables
+	struct timespec         now;                    // Current time
+	struct timespec         wake;                   // End of the coarse sleep
+
+	// Sleep coarsely until close to the deadline
+	wake = *deadline;
+	ts_add_nsec(&wake, -MT_SYNEXEC_SLAVE_SPIN_NSEC);
+	clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	if (ts_diff_nsec(&wake, &now) > 0){
+		while (clock_nanosleep(MT_SYNEXEC_CLOCK_WALL, TIMER_ABSTIME, &wake, NULL) == EINTR);
+	}
+
+	// Spin for the remainder
+	do {
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	} while (ts_diff_nsec(deadline, &now) > 0);
+}
+
+/*
+ * static void
+ * worker_wait_start(struct timespec *deadline);
+ * ---------------------------------------------
+ *  This function waits for the scheduled start of the armed worker at
+ *  'deadline' (see wait_until()), or returns right away if there is none. In
+ *  low jitter mode, the worker thread and the armed worker are raised to
+ *  SCHED_FIFO for the last MT_SYNEXEC_SLAVE_RT_NSEC before the deadline only,
+ *  and the thread spins for that time if there is a CPU to spare. They drop
+ *  back once the worker is released (see worker_start()).
+ *
+ *  Mandatory params: deadline
+ *  Optional params :
+ *
+ *  Return values:
+ *   None
+ */
+static void
+worker_wait_start(struct timespec *deadline){
+	// Local variables
+	struct timespec         now;                    // Current time
+	struct timespec         wake;                   // Start of the real-time window
+
+	// Start now
+	if (!deadline->tv_sec && !deadline->tv_nsec){
+		worker_sched(1);
+		return;
+	}
+	if (!low_jitter){
+		wait_until(deadline);
+		return;
+	}
+
+	// Sleep at normal priority until the window opens
+	wake = *deadline;
+	ts_add_nsec(&wake, -MT_SYNEXEC_SLAVE_RT_NSEC);
+	clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	if (ts_diff_nsec(&wake, &now) > 0){
+		while (clock_nanosleep(MT_SYNEXEC_CLOCK_WALL, TIMER_ABSTIME, &wake, NULL) == EINTR);
+	}
+
+	// Then wait for the deadline at real-time priority
+	worker_sched(1);
+	if (!worker_spin){
+		wait_until(deadline);
+		return;
+	}
+	do {
+		clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	} while (ts_diff_nsec(deadline, &now) > 0);
+}
+
+/*
+ * static int
+ * worker_signal(int worker_fd, int signum, struct timespec *deadline);
+ * --------------------------------------------------------------------
+ *  This function delivers 'signum' to the process group of the running worker
+ *  once 'deadline' is reached (see wait_until()), and reports the time it was
+ *  actually delivered to the master with a MT_SYNEXEC_MSG_STOPPED. If it could
+ *  not be delivered, the report carries a zero time and minus the errno.
+ *
+ *  Mandatory params: worker_fd, signum, deadline
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error (master connection)
+ *    0 Success
+ */
+static int
+worker_signal(int worker_fd, int signum, struct timespec *deadline){
+	// Local variables
+	synexec_signal_t        stopped;                // Delivery report
+	struct timespec         now;                    // Time of delivery
+
+	if (deadline->tv_sec || deadline->tv_nsec){
+		wait_until(deadline);
+	}
+	clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+	memset(&stopped, 0, sizeof(stopped));
+	if ((kill(-worker_pid, signum) < 0) && (kill(worker_pid, signum) < 0)){
+		perror("kill");
+		fprintf(stderr, "%s: Error delivering signal %d to the worker.\n", __FUNCTION__, signum);
+		stopped.signum = -errno;
+	}else{
+		if (verbose > 0){
+			printf("%s: Delivered signal %d to the worker.\n", __FUNCTION__, signum);
+			fflush(stdout);
+		}
+		ts_to_net(&now, &stopped.deliver);
+		stopped.signum = signum;
+	}
+
+	// Report when it was delivered, or that it was not
+	if (comm_send(worker_fd, MT_SYNEXEC_MSG_STOPPED, NULL, &stopped, sizeof(stopped)) < 0){
+		return(-1);
+	}
+	return(0);
+}
+
+/*
+ * static int
+ * output_flush(int worker_fd);
+ * ----------------------------
+ *  This function sends the worker output held in worker_out_buf to the master
+ *  with a MT_SYNEXEC_MSG_OUTPUT. The send blocks while the master does not keep
+ *  up, which stops the output pipe from being read, so the pipe fills up and a
+ *  chatty task ends up waiting for the master instead of growing a backlog.
+ *
+ *  Mandatory params: worker_fd
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+output_flush(int worker_fd){
+	if (!worker_out_len){
+		return(0);
+	}
+	if (verbose > 1){
+		printf("%s: Sending %d bytes of output to master...\n", __FUNCTION__, worker_out_len);
+		fflush(stdout);
+	}
+	if (comm_send(worker_fd, MT_SYNEXEC_MSG_OUTPUT, NULL, worker_out_buf, worker_out_len) < 0){
+		return(-1);
+	}
+	worker_out_len = 0;
+	return(0);
+}
+
+/*
+ * static int
+ * output_tail(int worker_fd);
+ * ---------------------------
+ *  This function sends the output of the worker kept in worker_ring to the
+ *  master, oldest first, in MT_SYNEXEC_MSG_OUTPUT messages. Once the ring
+ *  wrapped around, this is the last worker_ring_size bytes of output.
+ *
+ *  Mandatory params: worker_fd
+ *  Optional params :
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+output_tail(int worker_fd){
+	// Local variables
+	uint64_t                off;                    // Offset of the next byte to send
+	size_t                  len;                    // Bytes left to send
+	size_t                  n;                      // Bytes in the next message
+
+	len = (worker_ring_len < worker_ring_size)?worker_ring_len:worker_ring_size;
+	off = worker_ring_len - len;
+	if (verbose > 0){
+		printf("%s: Sending %zu bytes of output tail to master...\n", __FUNCTION__, len);
+		fflush(stdout);
+	}
+	while (len > 0){
+		n = worker_ring_size - (off % worker_ring_size);
+		n = (n < len)?n:len;
+		n = (n < MT_SYNEXEC_SLAVE_OUTPUT_BATCH)?n:MT_SYNEXEC_SLAVE_OUTPUT_BATCH;
+		if (comm_send(worker_fd, MT_SYNEXEC_MSG_OUTPUT, NULL, worker_ring+(off % worker_ring_size), n) < 0){
+			return(-1);
+		}
+		off += n;
+		len -= n;
+	}
+	return(0);
+}
+
+/*
+ * static int
+ * output_read(int worker_fd, int drain);
+ * --------------------------------------
+ *  This function reads the worker output from the output pipe into
+ *  worker_out_buf, sending it to the master whenever the buffer fills up.
+ *  Otherwise, output is batched for up to MT_SYNEXEC_SLAVE_OUTPUT_FLUSH msecs
+ *  (see handle_conn()). Unless 'drain' is set, at most one buffer is read so
+ *  a chatty task does not hold back commands from the master. With 'drain',
+ *  the pipe is read until empty and everything held is sent, which is done
+ *  before the worker is reported finished. The pipe is closed on end of file.
+ *  If the output is kept in memory instead, it is read into worker_ring,
+ *  overwriting the oldest output, and nothing is sent (see output_tail()).
+ *
+ *  Mandatory params: worker_fd
+ *  Optional params : drain
+ *
+ *  Return values:
+ *   -1 Error
+ *    0 Success
+ */
+static int
+output_read(int worker_fd, int drain){
+	// Local variables
+	ssize_t                 got;                    // Bytes read
+
+	while (worker_out >= 0){
+		if (worker_ring){
+			got = read(worker_out, worker_ring+(worker_ring_len % worker_ring_size),
+			           worker_ring_size-(worker_ring_len % worker_ring_size));
+		}else{
+			got = read(worker_out, worker_out_buf+worker_out_len, sizeof(worker_out_buf)-worker_out_len);
 		}
-		if (!strcmp(ptr, MT_SYNEXEC_CONF_TOKEN)){
-			if (!((*argv)[i] = strdup(conf_fn))){
-				goto err;
+		if (got < 0){
+			if (errno == EINTR){
+				continue;
 			}
-		}else{
-			if (!((*argv)[i] = strdup(ptr))){
-				goto err;
+			if (errno == EAGAIN){
+				break;
 			}
+			perror("read");
+			fprintf(stderr, "%s: Error reading worker output.\n", __FUNCTION__);
+		}
+		if (got <= 0){
+			close(worker_out);
+			worker_out = -1;
+			break;
 		}
-	}
-	
-	// Return number of arguments (including the terminating NULL)
-	err = argc;
 
-out:
-	// Return
-	return(err);
+		// Keep it in memory
+		if (worker_ring){
+			worker_ring_len += got;
+			if (!drain){
+				break;
+			}
+			continue;
+		}
 
-err:
-	err = -1;
-	free_argvp(argp, argv);
-	goto out;
+		// Batch it, sending full buffers right away
+		if (!worker_out_len){
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &worker_out_time);
+		}
+		worker_out_len += got;
+		if ((worker_out_len == sizeof(worker_out_buf)) && (output_flush(worker_fd) < 0)){
+			return(-1);
+		}
+		if (!drain){
+			break;
+		}
+	}
+	if (drain || (worker_out < 0)){
+		return(output_flush(worker_fd));
+	}
+	return(0);
 }
 
 /*
  * static int
- * handle_conn(int worker_fd, char *conf_fn);
- * ------------------------------------------
+ * handle_conn(int worker_fd, char *conf_fn, char *barrier_fn);
+ * ------------------------------------------------------------
  *  This function implements a loop that handles the slave TCP connection with
- *  a master process.
+ *  a master process. The loop waits on the master socket together with the
+ *  pidfd of the worker, so MT_SYNEXEC_MSG_FINISHD is sent as soon as the
+ *  worker is reaped. Without a pidfd, completion is noticed when the wait
+ *  times out (SYNEXEC_COMM_TIMEOUT_SEC). If the master asked for heartbeats,
+ *  the wait also wakes up to send them while the worker runs, and to deliver
+ *  the signal the master scheduled with MT_SYNEXEC_MSG_SIGNAL. Tasks entering
+ *  a barrier on the socket at 'barrier_fn' are reported to the master, which
+ *  sends back the deadline at which to release them. If the output of the
+ *  worker is streamed to the master or kept in memory, the wait also covers
+ *  the output pipe. Output kept in memory is sent to the master when the
+ *  worker fails and on MT_SYNEXEC_MSG_TAIL. The number of instances of the
+ *  next execution is set with MT_SYNEXEC_MSG_INSTANCES.
  *
- *  Mandatory params: worker_fd, conf_fn
+ *  Mandatory params: worker_fd, conf_fn, barrier_fn
  *  Optional params :
  *
  *  Return values:
@@ -221,14 +1290,40 @@ err:
  *    0 Success
  */
 static int
-handle_conn(int worker_fd, char *conf_fn){
+handle_conn(int worker_fd, char *conf_fn, char *barrier_fn){
 	// Local variables
 	int                     master_eof = 0;         // Master connection keep alive
 	FILE                    *conf_fp = NULL;        // Configuration file pointer
-	int                     exec_fd  = -1;          // Redirected output of forked worker
 
 	synexec_msg_t           net_msg;                // Synexec msg
 	char                    *data = NULL;           // Synexec msg data
+	synexec_exec_t          exec_req;               // Scheduled execution request
+	synexec_exec_ok_t       exec_rep;               // Scheduled execution report
+	synexec_sync_t          sync;                   // Clock synchronisation sample
+	synexec_stream_t        stream;                 // Streamed configuration header
+	synexec_conf_t          conf_req;               // Configuration hash announced by the master
+	char                    conf_hashed = 0;        // Verify (and cache) the next configuration
+	char                    conf_nl;                // Command line ended with a line break
+	char                    *conf_path = NULL;      // Cached configuration file (instead of conf_fn)
+	synexec_fetch_t         fetch;                  // Peer to fetch the configuration from
+	int                     conf_sock;              // Socket the configuration arrives on
+	struct timeval          conf_timeo;             // Longest stall streaming from a peer
+	int                     conf_head;              // Configuration bytes held in 'data'
+	uint64_t                conf_left;              // Configuration bytes left to stream
+	struct timespec         now;                    // Current time
+	struct timespec         exec_time;              // Time worker called execv()
+	struct pollfd           pfd[4];                 // Master socket, worker pidfd, barrier socket and output pipe
+	synexec_barrier_t       barrier;                // Barrier entered or released
+	int                     barrier_sent = 0;       // Barrier being waited on was reported to the master
+	struct timespec         barrier_time;           // Barrier release deadline
+	synexec_signal_t        sig_req;                // Scheduled signal request
+	struct timespec         sig_time;               // Signal delivery deadline
+	int                     sig_num = 0;            // Signal to deliver, zero for none
+	synexec_instances_t     inst_req;               // Instances of the next execution
+	int                     wait;                   // Time to wait for events (msecs)
+	struct timespec         mono;                   // Current time (MT_SYNEXEC_CLOCK_MONO)
+	int64_t                 beat_ival = 0;          // Heartbeat interval (nsecs), zero for none
+	struct timespec         beat_next;              // Time the next heartbeat is due
 
 	char                    **argv = NULL;          // Arg array for command line
 	char                    *argp = NULL;           // Path for command line
@@ -236,45 +1331,207 @@ handle_conn(int worker_fd, char *conf_fn){
 
 	char                    *ptr  = NULL;           // Temporary pointer
 	int                     i;                      // Temporary integer
+	int                     j;                      // Temporary integer
 	int                     err = 0;                // Return value
 
+	// Let tasks enter barriers, the session can do without them
+	pfd[2].fd = barrier_open(barrier_fn);
+	inst_req.count = 1;
+	inst_req.pin = 0;
+
 	// Loop listening for commands
+	conf_sock = worker_fd;
+	conf_timeo.tv_sec = SYNEXEC_SLAVE_PEER_STREAMTIMEO_SEC;
+	conf_timeo.tv_usec = 0;
 	while(!quit && !master_eof){
 		if (verbose > 0){
 			printf("%s: About to wait for commands from the master...\n", __FUNCTION__);
 		}
 		if (data){
-			free(data);
+			comm_free(data);
 			data = NULL;
 		}
+
+		// Wake up in time for the next heartbeat while the worker runs
+		wait = (SYNEXEC_COMM_TIMEOUT_SEC * 1000) + (SYNEXEC_COMM_TIMEOUT_USEC / 1000);
+		if (beat_ival && worker_pid){
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono);
+			i = (ts_diff_nsec(&beat_next, &mono) + 999999) / 1000000;
+			wait = (i < 0)?0:((i < wait)?i:wait);
+		}
+
+		// Wake up in time to deliver a scheduled signal
+		if (sig_num && worker_pid){
+			clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+			i = (ts_diff_nsec(&sig_time, &now) - MT_SYNEXEC_SLAVE_SPIN_NSEC) / 1000000;
+			wait = (i < 0)?0:((i < wait)?i:wait);
+		}
+
+		// Do not hold output back for long
+		if (worker_out_len){
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono);
+			i = MT_SYNEXEC_SLAVE_OUTPUT_FLUSH - (ts_diff_nsec(&mono, &worker_out_time) / 1000000);
+			wait = (i < 0)?0:((i < wait)?i:wait);
+		}
+
+		// Notice instances finishing while the others wait on a barrier
+		if (!barrier_sent && worker_supervised && (barrier_waiting(barrier.name) > 0)){
+			wait = (MT_SYNEXEC_SLAVE_INSTANCE_POLL < wait)?MT_SYNEXEC_SLAVE_INSTANCE_POLL:wait;
+		}
+
+		// Do not wait if a command from the master is already buffered
+		if (comm_pending(worker_fd)){
+			wait = 0;
+		}
+
+		// Wait for a command from the master or for the worker to finish
+		pfd[0].fd = worker_fd;
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfd[1].fd = worker_pidfd;
+		pfd[1].events = POLLIN;
+		pfd[1].revents = 0;
+		pfd[2].events = POLLIN;
+		pfd[2].revents = 0;
+		pfd[3].fd = worker_out;
+		pfd[3].events = POLLIN;
+		pfd[3].revents = 0;
+		i = poll(pfd, 4, wait);
+		if ((i < 0) && (errno != EINTR)){
+			perror("poll");
+			fprintf(stderr, "%s: Error waiting for the master or the worker.\n", __FUNCTION__);
+			goto err;
+		}
+		if ((i == 0) && comm_pending(worker_fd)){
+			pfd[0].revents = POLLIN;
+			i = 1;
+		}
+		if ((i > 0) && (pfd[1].revents & POLLIN)){
+			worker_reap(WNOHANG);
+		}
+
+		// Stream the worker output, if due
+		if ((i > 0) && pfd[3].revents && (output_read(worker_fd, 0) < 0)){
+			master_eof = 1;
+			break;
+		}
+		if (worker_out_len){
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono);
+			if ((ts_diff_nsec(&mono, &worker_out_time) >= (int64_t)MT_SYNEXEC_SLAVE_OUTPUT_FLUSH * 1000000) &&
+			    (output_flush(worker_fd) < 0)){
+				master_eof = 1;
+				break;
+			}
+		}
+
+		// If finished working, report back
+		if (worker_time[1].tv_sec || worker_time[1].tv_nsec){
+			synexec_finishd_t finishd;
+
+			// Marshal data
+			ts_to_net(&worker_time[0], &finishd.time[0]);
+			ts_to_net(&worker_time[1], &finishd.time[1]);
+			finishd.elapsed = ts_diff_nsec(&worker_mono[1], &worker_mono[0]);
+			finishd.status = worker_status;
+			ru_to_net(&worker_rusage, &finishd.rusage);
+
+			// Send the remaining output first, or the last of it if the worker failed, and the instance reports
+			if ((output_read(worker_fd, 1) < 0) ||
+			    (worker_ring && (worker_status != 0) && (output_tail(worker_fd) < 0)) ||
+			    (worker_instances_report(worker_fd) < 0)){
+				master_eof = 1;
+				break;
+			}
+
+			printf("%s: Work finished. Notifying master...\n", __FUNCTION__);
+			fflush(stdout);
+			i = comm_send(worker_fd, MT_SYNEXEC_MSG_FINISHD, NULL, &finishd, sizeof(finishd));
+			memset(&worker_time, 0, sizeof(worker_time));
+			beat_ival = 0;
+			sig_num = 0;
+			if (i <= 0){
+				master_eof = 1;
+				break;
+			}
+
+			// Arm a new worker, so the master can run the configuration again
+			if (argv && (worker_arm(worker_fd, argp, argv) != 0)){
+				fprintf(stderr, "%s: Error arming a worker for the next execution.\n", __FUNCTION__);
+			}
+			continue;
+		}
+
+		// Report progress, if due
+		if (beat_ival && worker_pid){
+			clock_gettime(MT_SYNEXEC_CLOCK_MONO, &mono);
+			if (ts_diff_nsec(&mono, &beat_next) >= 0){
+				if (worker_beat(worker_fd) < 0){
+					master_eof = 1;
+					break;
+				}
+				beat_next = mono;
+				ts_add_nsec(&beat_next, beat_ival);
+			}
+		}
+
+		// Deliver the scheduled signal, if due
+		if (sig_num && worker_pid){
+			clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+			if (ts_diff_nsec(&sig_time, &now) <= MT_SYNEXEC_SLAVE_SPIN_NSEC){
+				i = worker_signal(worker_fd, sig_num, &sig_time);
+				sig_num = 0;
+				if (i < 0){
+					master_eof = 1;
+					break;
+				}
+			}
+		}
+
+		// Let tasks enter a barrier
+		if ((i > 0) && (pfd[2].revents & POLLIN)){
+			(void)barrier_accept();
+		}
+
+		// Report it once all instances of the task still running entered it
+		memset(&barrier, 0, sizeof(barrier));
+		if (!barrier_sent && ((j = barrier_waiting(barrier.name)) > 0) && (j >= worker_instances_left())){
+			barrier_sent = 1;
+			if (comm_send(worker_fd, MT_SYNEXEC_MSG_BARRIER, NULL, &barrier, sizeof(barrier)) < 0){
+				master_eof = 1;
+				break;
+			}
+		}
+		if ((i <= 0) || !pfd[0].revents){
+			continue;
+		}
+
 		i = comm_recv(worker_fd, &net_msg, NULL, (void **)&data, NULL);
 		if (i == -1){
 			master_eof = 1;
 			break;
 		}else
 		if (i == 0){
-			// If finished working, report back
-			if (memcmp(&worker_time[1], &worker_time[2], sizeof(worker_time[1]))){
-				struct {
-					int64_t tv_sec;
-					int64_t tv_usec;
-				} net_time[3];
-
-				// Marshal data
-				net_time[0].tv_sec = worker_time[0].tv_sec; net_time[0].tv_usec = worker_time[0].tv_usec;
-				net_time[1].tv_sec = worker_time[1].tv_sec; net_time[1].tv_usec = worker_time[1].tv_usec;
-				net_time[2].tv_sec = worker_time[2].tv_sec; net_time[2].tv_usec = worker_time[2].tv_usec;
-
-				printf("%s: Work finished. Notifying master...\n", __FUNCTION__);
-				fflush(stdout);
-				i = comm_send(worker_fd, MT_SYNEXEC_MSG_FINISHD, NULL, &net_time, sizeof(net_time));
-				memset(&worker_time, 0, sizeof(worker_time));
-				if (i <= 0){
+			continue;
+		}
+
+		// Fetch the configuration from a peer if told so, it is then processed as if streamed by the master
+		if (net_msg.command == MT_SYNEXEC_MSG_FETCH){
+			if (net_msg.datalen != sizeof(fetch)){
+				fprintf(stderr, "%s: Wrong datalen for FETCH.\n", __FUNCTION__);
+				goto err;
+			}
+			memcpy(&fetch, data, sizeof(fetch));
+			comm_free(data);
+			data = NULL;
+			if ((conf_sock = peer_fetch(&fetch, &net_msg, &data)) < 0){
+				conf_sock = worker_fd;
+				if (comm_send(worker_fd, MT_SYNEXEC_MSG_CONF_MISS, NULL, NULL, 0) < 0){
 					master_eof = 1;
-					break;
 				}
+				continue;
 			}
-			continue;
+			conf_req = fetch.conf;
+			conf_hashed = 1;
 		}
 
 		// Process packet received
@@ -283,16 +1540,89 @@ handle_conn(int worker_fd, char *conf_fn){
 				printf("%s: Received PROBE from master...\n", __FUNCTION__);
 				fflush(stdout);
 			}
-			if (comm_send(worker_fd, MT_SYNEXEC_MSG_REPLY, NULL, NULL, 0) < 0){
+			if (net_msg.datalen == sizeof(synexec_time_t)){
+				// Timestamped probe, reply with our clock readings
+				clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+				memcpy(&sync.t1, data, sizeof(sync.t1));
+				ts_to_net(&now, &sync.t2);
+				clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+				ts_to_net(&now, &sync.t3);
+				i = comm_send(worker_fd, MT_SYNEXEC_MSG_REPLY, NULL, &sync, sizeof(sync));
+			}else{
+				i = comm_send(worker_fd, MT_SYNEXEC_MSG_REPLY, NULL, NULL, 0);
+			}
+			if (i < 0){
 				master_eof = 1;
 			}
 		}else
-		if (net_msg.command == MT_SYNEXEC_MSG_CONF){
+		if ((net_msg.command == MT_SYNEXEC_MSG_CONF) ||
+		    (net_msg.command == MT_SYNEXEC_MSG_CONF_STREAM) ||
+		    (net_msg.command == MT_SYNEXEC_MSG_CONF_HASH)){
 			if (verbose > 0){
 				printf("%s: Received CONF from master...\n", __FUNCTION__);
 				fflush(stdout);
 			}
 
+			// Fetch the command line (and start of the file) of a streamed configuration
+			conf_head = net_msg.datalen;
+			conf_left = 0;
+			if (net_msg.command == MT_SYNEXEC_MSG_CONF_STREAM){
+				if (net_msg.datalen != sizeof(stream)){
+					fprintf(stderr, "%s: Wrong datalen for CONF_STREAM.\n", __FUNCTION__);
+					goto err;
+				}
+				memcpy(&stream, data, sizeof(stream));
+				conf_head = (stream.length < MT_SYNEXEC_SLAVE_CMDLINE_MAX)?stream.length:MT_SYNEXEC_SLAVE_CMDLINE_MAX;
+				conf_left = stream.length - conf_head;
+				comm_free(data);
+				if ((data = calloc(1, conf_head+1)) == NULL){
+					perror("calloc");
+					fprintf(stderr, "%s: Error allocating %d bytes for configuration.\n", __FUNCTION__, conf_head+1);
+					goto err;
+				}
+				if ((conf_head) && (comm_recv_raw(conf_sock, (conf_sock != worker_fd)?&conf_timeo:NULL, data, conf_head) < 0)){
+					if (conf_sock != worker_fd){
+						goto conf_miss;
+					}
+					master_eof = 1;
+					break;
+				}
+				if (verbose > 0){
+					printf("%s: Streaming %" PRIu64 " bytes of configuration...\n", __FUNCTION__, stream.length);
+					fflush(stdout);
+				}
+			}
+
+			// Discard any previous configuration
+			if (worker_go >= 0){
+				worker_disarm();
+			}
+			free_argvp(&argp, &argv);
+			if (conf_path){
+				free(conf_path);
+				conf_path = NULL;
+			}
+
+			// Look the configuration up in the cache, it is only sent on a miss
+			if (net_msg.command == MT_SYNEXEC_MSG_CONF_HASH){
+				if (net_msg.datalen != sizeof(conf_req)){
+					fprintf(stderr, "%s: Wrong datalen for CONF_HASH.\n", __FUNCTION__);
+					goto conf_deny;
+				}
+				memcpy(&conf_req, data, sizeof(conf_req));
+				conf_hashed = 1;
+				if (cache_lookup(&conf_req, &ptr, &conf_path) <= 0){
+					if (comm_send(worker_fd, MT_SYNEXEC_MSG_CONF_MISS, NULL, NULL, 0) < 0){
+						master_eof = 1;
+					}
+					continue;
+				}
+				conf_hashed = 0;
+				comm_free(data);
+				data = ptr;
+				goto conf_maybe;
+			}
+
 			// First, open the configuration file
 			if ((conf_fp = fopen(conf_fn, "w")) == NULL){
 				perror("fopen");
@@ -301,9 +1631,11 @@ handle_conn(int worker_fd, char *conf_fn){
 			}
 
 			// Detect where the actual command (first line) ends
+			conf_nl = 0;
 			if ((ptr = strchr(data, '\n')) != NULL){
 				// Split the first line
 				*ptr++ = 0;
+				conf_nl = 1;
 
 				// Check if there's anything at all in 'data'
 				if (!*data){
@@ -311,15 +1643,21 @@ handle_conn(int worker_fd, char *conf_fn){
 					goto conf_deny;
 				}
 
-				// Check if there's anything else in 'ptr'
-				if (!*ptr){
+				// Check if there's anything else in 'ptr' (or still to stream)
+				if (!*ptr && !conf_left){
 					if (verbose > 0){
 						printf("%s: Configuration file empty.\n", __FUNCTION__);
 						fflush(stdout);
 					}
-					goto conf_maybe;
+					goto conf_check;
 				}
 			}else{
+				// The command line must fit in the start of a streamed file
+				if (conf_left){
+					fprintf(stderr, "%s: Error parsing configuration file: command line longer than %d bytes.\n", __FUNCTION__, MT_SYNEXEC_SLAVE_CMDLINE_MAX);
+					goto conf_deny;
+				}
+
 				// It could be that there is only one line, but no line break
 				ptr = data+strlen(data);
 
@@ -328,18 +1666,53 @@ handle_conn(int worker_fd, char *conf_fn){
 					goto conf_deny;
 				}
 
-				goto conf_maybe;
+				goto conf_check;
 			}
 			// Write the configuration file to disk
-			if (fwrite(ptr, 1, net_msg.datalen-(ptr-data), conf_fp) < 0){
+			if (fwrite(ptr, 1, conf_head-(ptr-data), conf_fp) < 0){
 				perror("fwrite");
-				fprintf(stderr, "%s: Error writing %hu bytes to configuration file '%s'.\n", __FUNCTION__, net_msg.datalen-(uint16_t)(ptr-data), conf_fn);
+				fprintf(stderr, "%s: Error writing %d bytes to configuration file '%s'.\n", __FUNCTION__, conf_head-(int)(ptr-data), conf_fn);
 				goto err;
 			}
 
+			// Stream the remainder straight to disk
+			if (conf_left){
+				if (fflush(conf_fp) != 0){
+					perror("fflush");
+					fprintf(stderr, "%s: Error writing configuration file '%s'.\n", __FUNCTION__, conf_fn);
+					goto err;
+				}
+				i = comm_recv_stream(conf_sock, (conf_sock != worker_fd)?&conf_timeo:NULL, fileno(conf_fp), conf_left);
+				conf_left = 0;
+				if (i < 0){
+					fprintf(stderr, "%s: Error receiving configuration file '%s'.\n", __FUNCTION__, conf_fn);
+					if (conf_sock != worker_fd){
+						goto conf_miss;
+					}
+					goto err;
+				}
+			}
+
+conf_check:
+			// Verify the file against the hash announced by the master and cache it
+			if (conf_hashed){
+				conf_hashed = 0;
+				if (fflush(conf_fp) != 0){
+					perror("fflush");
+					fprintf(stderr, "%s: Error writing configuration file '%s'.\n", __FUNCTION__, conf_fn);
+					goto err;
+				}
+				if (cache_store(&conf_req, data, conf_nl, conf_fn, &conf_path) < 0){
+					if (conf_sock != worker_fd){
+						goto conf_miss;
+					}
+					goto conf_deny;
+				}
+			}
+
 conf_maybe:
 			// Validate if the command given is executable
-			if ((argc = make_argv(data, conf_fn, &argp, &argv)) <= 0){
+			if ((argc = make_argv(data, conf_path?conf_path:conf_fn, &argp, &argv)) <= 0){
 				fprintf(stderr, "%s: Error parsing command line '%s'.\n", __FUNCTION__, data);
 				goto conf_deny;
 			}
@@ -347,82 +1720,257 @@ conf_maybe:
 				fprintf(stderr, "%s: Error, unable to execute command '%s'.\n", __FUNCTION__, data);
 				goto conf_deny;
 			}
+			if (conf_fp && (fflush(conf_fp) != 0)){
+				perror("fflush");
+				fprintf(stderr, "%s: Error writing configuration file '%s'.\n", __FUNCTION__, conf_fn);
+				goto err;
+			}
+			if (worker_pid != 0){
+				fprintf(stderr, "%s: Error, unable to arm a worker while another one is running.\n", __FUNCTION__);
+				goto conf_deny;
+			}
+			if (worker_arm(worker_fd, argp, argv) != 0){
+				goto conf_deny;
+			}
 //conf_accept:
 			// Accept the configuration command
 			if (comm_send(worker_fd, MT_SYNEXEC_MSG_CONF_OK, NULL, NULL, 0) < 0){
 				master_eof = 1;
 			}
 			goto conf_close;
+conf_miss:
+			// Ask the master for the configuration, the peer could not provide it
+			if (conf_sock != worker_fd){
+				conf_hashed = 0;
+				conf_left = 0;
+				if (comm_send(worker_fd, MT_SYNEXEC_MSG_CONF_MISS, NULL, NULL, 0) < 0){
+					master_eof = 1;
+				}
+				goto conf_close;
+			}
 conf_deny:
+			conf_hashed = 0;
+
+			// Drain the rest of a streamed file
+			if (conf_left && (conf_sock == worker_fd)){
+				i = comm_recv_stream(worker_fd, NULL, -1, conf_left);
+				conf_left = 0;
+				if (i < 0){
+					master_eof = 1;
+				}
+			}
+
 			// Reject the configuration command
 			if (comm_send(worker_fd, MT_SYNEXEC_MSG_CONF_NO, NULL, NULL, 0) < 0){
 				master_eof = 1;
 			}
 			free_argvp(&argp, &argv);
 conf_close:
-			fclose(conf_fp);
-			conf_fp = NULL;
+			if (conf_fp){
+				fclose(conf_fp);
+				conf_fp = NULL;
+			}
+			if (conf_sock != worker_fd){
+				comm_close(conf_sock);
+				conf_sock = worker_fd;
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_ABORT){
+			printf("%s: Received ABORT from master...\n", __FUNCTION__);
+			fflush(stdout);
+
+			// Kill the whole task, it is reported with FINISHD once reaped
+			sig_num = 0;
+			if (worker_go >= 0){
+				worker_disarm();
+			}else
+			if (worker_pid && (kill(-worker_pid, SIGKILL) < 0) && (kill(worker_pid, SIGKILL) < 0)){
+				perror("kill");
+				fprintf(stderr, "%s: Error killing the worker.\n", __FUNCTION__);
+			}
+			barrier_cancel();
+			barrier_sent = 0;
+
+			// Drop the configuration, so nothing runs again until a new one arrives
+			free_argvp(&argp, &argv);
+			if (conf_path){
+				free(conf_path);
+				conf_path = NULL;
+			}
+			if (conf_fp){
+				fclose(conf_fp);
+				conf_fp = NULL;
+			}
+			if (access(conf_fn, W_OK) == 0){
+				unlink(conf_fn);
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_INSTANCES){
+			if (net_msg.datalen != sizeof(inst_req)){
+				fprintf(stderr, "%s: Wrong datalen for INSTANCES.\n", __FUNCTION__);
+				continue;
+			}
+			memcpy(&inst_req, data, sizeof(inst_req));
+			if (verbose > 0){
+				printf("%s: Running %d instances%s next.\n", __FUNCTION__, inst_req.count, inst_req.pin?" (pinned)":"");
+				fflush(stdout);
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_TAIL){
+			// Send the output kept so far, if any
+			if (worker_ring && ((output_read(worker_fd, 1) < 0) || (output_tail(worker_fd) < 0))){
+				master_eof = 1;
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_SIGNAL){
+			if (net_msg.datalen != sizeof(sig_req)){
+				fprintf(stderr, "%s: Wrong datalen for SIGNAL.\n", __FUNCTION__);
+				continue;
+			}
+			memcpy(&sig_req, data, sizeof(sig_req));
+			if (!worker_pid || (worker_go >= 0) || (sig_req.signum <= 0)){
+				if (verbose > 0){
+					printf("%s: Ignoring SIGNAL, the worker is not running.\n", __FUNCTION__);
+					fflush(stdout);
+				}
+				continue;
+			}
+
+			// Schedule the delivery, it happens from the loop above
+			net_to_ts(&sig_req.deliver, &sig_time);
+			sig_num = sig_req.signum;
+			if (verbose > 0){
+				printf("%s: Signal %d scheduled for %ld.%09ld.\n", __FUNCTION__, sig_num,
+				       (long)sig_time.tv_sec, sig_time.tv_nsec);
+				fflush(stdout);
+			}
+		}else
+		if (net_msg.command == MT_SYNEXEC_MSG_BARRIER){
+			if (net_msg.datalen != sizeof(barrier)){
+				fprintf(stderr, "%s: Wrong datalen for BARRIER.\n", __FUNCTION__);
+				continue;
+			}
+			memcpy(&barrier, data, sizeof(barrier));
+			barrier.name[sizeof(barrier.name)-1] = 0;
+
+			// Wait for the release deadline, as for a scheduled start
+			net_to_ts(&barrier.release, &barrier_time);
+			if (barrier_time.tv_sec || barrier_time.tv_nsec){
+				wait_until(&barrier_time);
+			}
+			clock_gettime(MT_SYNEXEC_CLOCK_WALL, &now);
+			i = barrier_release(barrier.name);
+			barrier_sent = 0;
+			if (verbose > 0){
+				printf("%s: Released %d tasks from barrier '%s'.\n", __FUNCTION__, i, barrier.name);
+				fflush(stdout);
+			}
+
+			// Report when it was actually released
+			ts_to_net(&now, &barrier.release);
+			if (comm_send(worker_fd, MT_SYNEXEC_MSG_BARRIER_OK, NULL, &barrier, sizeof(barrier)) < 0){
+				master_eof = 1;
+			}
 		}else
-		if (net_msg.command == MT_SYNEXEC_MSG_EXEC){
+		if ((net_msg.command == MT_SYNEXEC_MSG_EXEC) ||
+		    (net_msg.command == MT_SYNEXEC_MSG_EXEC_AT)){
+			// Fetch the start deadline, if any
+			memset(&exec_req, 0, sizeof(exec_req));
+			if (net_msg.command == MT_SYNEXEC_MSG_EXEC_AT){
+				if (net_msg.datalen != sizeof(exec_req)){
+					fprintf(stderr, "%s: Wrong datalen for EXEC_AT. Rejecting.\n", __FUNCTION__);
+					if (comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_NO, NULL, NULL, 0) < 0){
+						master_eof = 1;
+					}
+					continue;
+				}
+				memcpy(&exec_req, data, sizeof(exec_req));
+			}
+
 			if (!argv){
 				fprintf(stderr, "%s: Master called EXEC without a valid CONFIG. Rejecting.\n", __FUNCTION__);
 				if (comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_NO, NULL, NULL, 0) < 0){
 					master_eof = 1;
 				}
 			}else
-			if (worker_pid != 0){
-				fprintf(stderr, "%s: Master called EXEC while a worker is already running. Rejecting.\n", __FUNCTION__);
+			if (worker_go < 0){
+				fprintf(stderr, "%s: Master called EXEC without an armed worker (already running?). Rejecting.\n", __FUNCTION__);
 				if (comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_NO, NULL, NULL, 0) < 0){
 					master_eof = 1;
 				}
 			}else{
-				worker_pid = fork();
-				if (worker_pid < 0){
-					// Fork failed
-					perror("fork");
-					fprintf(stderr, "%s: Error forking worker.\n", __FUNCTION__);
+				// Wait for the scheduled start
+				net_to_ts(&exec_req.start, &worker_time[0]);
+				if ((verbose > 0) && (worker_time[0].tv_sec || worker_time[0].tv_nsec)){
+					printf("%s: Waiting to start at %ld.%09ld...\n", __FUNCTION__,
+					       (long)worker_time[0].tv_sec, worker_time[0].tv_nsec);
+					fflush(stdout);
+				}
+				worker_wait_start(&worker_time[0]);
+
+				// Get time worker started
+				clock_gettime(MT_SYNEXEC_CLOCK_MONO, &worker_mono[0]);
+				clock_gettime(MT_SYNEXEC_CLOCK_WALL, &worker_time[0]);
+				memset(&worker_time[1], 0, sizeof(worker_time[1]));
+
+				// Release the armed worker, with no output kept from the previous one
+				worker_ring_len = 0;
+				i = worker_start(&exec_time, &inst_req);
+				inst_req.count = 1;
+				inst_req.pin = 0;
+				if (i != 0){
+					memset(&worker_time, 0, sizeof(worker_time));
 					if (comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_NO, NULL, NULL, 0) < 0){
 						master_eof = 1;
 					}
-					goto err;
-				}else
-				if (worker_pid == 0){
-					// Child
-					close(worker_fd);
-					if ((exec_fd = creat(MT_SYNEXEC_SLAVE_OUTPUT, S_IRUSR|S_IWUSR)) < 0){
-						perror("creat");
-						goto err;
-					}
-					close(fileno(stdout));
-					close(fileno(stderr));
-					if ((dup2(exec_fd, fileno(stdout)) < 0) ||
-					    (dup2(exec_fd, fileno(stderr)) < 0)){
-						perror("dup2");
-						goto err;
-					}
-					execv(argp, argv);
-					goto err;
-				}else{
-					// Get time worker started
-					gettimeofday(&worker_time[0], NULL);
-					memset(&worker_time[1], 0, sizeof(worker_time[1]));
+					continue;
+				}
 
-					// Parent
-					if (comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_OK, NULL, NULL, 0) < 0){
-						master_eof = 1;
-					}
+				// Send heartbeats while it runs, if requested
+				beat_ival = (int64_t)exec_req.heartbeat * 1000000;
+				beat_next = worker_mono[0];
+				ts_add_nsec(&beat_next, beat_ival);
+
+				if (net_msg.command == MT_SYNEXEC_MSG_EXEC_AT){
+					// Report intended, actual and exec start times
+					exec_rep.intended = exec_req.start;
+					ts_to_net(&worker_time[0], &exec_rep.actual);
+					ts_to_net(&exec_time, &exec_rep.exec);
+					i = comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_OK, NULL, &exec_rep, sizeof(exec_rep));
+				}else{
+					i = comm_send(worker_fd, MT_SYNEXEC_MSG_EXEC_OK, NULL, NULL, 0);
+				}
+				if (i < 0){
+					master_eof = 1;
 				}
 			}
 		}
 	}
 
-
 out:
+	worker_disarm();
+	barrier_close(barrier_fn);
+	if (worker_out >= 0){
+		close(worker_out);
+		worker_out = -1;
+	}
+	worker_out_len = 0;
+	if (worker_inst >= 0){
+		close(worker_inst);
+		worker_inst = -1;
+	}
 	if (argv){
 		free_argvp(&argp, &argv);
 	}
+	if (conf_path){
+		free(conf_path);
+		conf_path = NULL;
+	}
+	if (conf_sock != worker_fd){
+		comm_close(conf_sock);
+	}
 	if (data){
-		free(data);
+		comm_free(data);
 		data = NULL;
 	}
 	if (conf_fp){
@@ -459,6 +2007,8 @@ worker(){
 	int                     worker_fd = -1;         // Worker TCP socket
 	struct sockaddr_in      worker_addr;            // Local copy of master address
 	char                    *conf_fn = NULL;        // Configuration file name
+	char                    *barrier_fn = NULL;     // Barrier socket name
+	int                     i;                      // Temporary integer
 
 	// Initialise configuration file path name
 	if (asprintf(&conf_fn, "%s/synexec_slave_conf.%d", MT_SYNEXEC_SLAVE_CONFDIR, getpid()) < 0){
@@ -473,6 +2023,32 @@ worker(){
 		goto err;
 	}
 
+	// Initialise barrier socket path name, tasks find it in their environment
+	if (asprintf(&barrier_fn, "%s.%d", MT_SYNEXEC_SLAVE_BARRIER_PATH, getpid()) < 0){
+		perror("asprintf");
+		fprintf(stderr, "%s: Error allocating memory for barrier socket name.\n", __FUNCTION__);
+		barrier_fn = NULL;
+		goto err;
+	}
+	if (setenv(MT_SYNEXEC_SLAVE_BARRIER_ENV, barrier_fn, 1) < 0){
+		perror("setenv");
+		fprintf(stderr, "%s: Error setting %s.\n", __FUNCTION__, MT_SYNEXEC_SLAVE_BARRIER_ENV);
+		goto err;
+	}
+
+	// Allocate the ring for task output kept in memory
+	if (ring_output){
+		worker_ring_size = (size_t)ring_output * 1024;
+		if ((worker_ring = malloc(worker_ring_size)) == NULL){
+			perror("malloc");
+			fprintf(stderr, "%s: Error allocating %d KiB for task output.\n", __FUNCTION__, ring_output);
+			goto err;
+		}
+	}
+
+	// Spin up to scheduled starts in low jitter mode, unless that would hold up the only CPU
+	worker_spin = low_jitter && (sysconf(_SC_NPROCESSORS_ONLN) > 1);
+
 	// Initialise sigchld signal handler and time vals
 	signal(SIGCHLD, sigchld_h);
 
@@ -508,13 +2084,25 @@ worker(){
 			perror("connect");
 			fprintf(stderr, "%s: Error connecting to master at '%s:%hu'. Looping...\n", __FUNCTION__,
 				inet_ntoa(worker_addr.sin_addr), ntohs(worker_addr.sin_port));
-			close(worker_fd);
+			comm_close(worker_fd);
 			worker_fd = -1;
 			pthread_mutex_lock(&master_mutex);
 			memset(&master_addr, 0, sizeof(master_addr));
 			pthread_mutex_unlock(&master_mutex);
 			continue;
 		}
+		i = 1; // TCP_NODELAY = true, so timestamped replies are not held back by Nagle
+		if (setsockopt(worker_fd, IPPROTO_TCP, TCP_NODELAY, &i, sizeof(i)) < 0){
+			perror("setsockopt");
+			fprintf(stderr, "%s: Error setting TCP_NODELAY to worker socket.\n", __FUNCTION__);
+		}
+#ifdef SO_BUSY_POLL
+		i = MT_SYNEXEC_SLAVE_BUSY_POLL; // Have the kernel busy-poll the device for master messages
+		if (low_jitter && (setsockopt(worker_fd, SOL_SOCKET, SO_BUSY_POLL, &i, sizeof(i)) < 0)){
+			perror("setsockopt");
+			fprintf(stderr, "%s: Error setting SO_BUSY_POLL to worker socket.\n", __FUNCTION__);
+		}
+#endif
 		if (verbose > 0){
 			printf("%s: Connected to '%s:%hu'.\n", __FUNCTION__,
 				inet_ntoa(worker_addr.sin_addr), ntohs(worker_addr.sin_port));
@@ -527,7 +2115,7 @@ worker(){
 
 		// Handle connection loop
 		memset(&worker_time, 0, sizeof(worker_time));
-		if (handle_conn(worker_fd, conf_fn) != 0){
+		if (handle_conn(worker_fd, conf_fn, barrier_fn) != 0){
 			goto err;
 		}
 
@@ -538,7 +2126,7 @@ worker(){
 
 conn_fail:
 		// Close connection
-		close(worker_fd);
+		comm_close(worker_fd);
 		worker_fd = -1;
 		pthread_mutex_lock(&master_mutex);
 		memset(&master_addr, 0, sizeof(master_addr));
@@ -558,7 +2146,7 @@ err:
 out:
 	// Release resources
 	if (worker_fd >= 0){
-		close(worker_fd);
+		comm_close(worker_fd);
 	}
 	if (conf_fn){
 		if (access(conf_fn, W_OK) == 0){
@@ -567,6 +2155,14 @@ out:
 		free(conf_fn);
 		conf_fn = NULL;
 	}
+	if (barrier_fn){
+		free(barrier_fn);
+		barrier_fn = NULL;
+	}
+	if (worker_ring){
+		free(worker_ring);
+		worker_ring = NULL;
+	}
 
 	// Return
 	return NULL;
@@ -28,6 +28,16 @@
 // Global definitions
 #define MT_SYNEXEC_SLAVE_CONFDIR        "/tmp/"                 // Directory to place temporary configuration files
 #define MT_SYNEXEC_SLAVE_OUTPUT         "/tmp/synexec.out"      // Redirected output of forked worker
+#define MT_SYNEXEC_SLAVE_OUTPUT_BATCH   16384                   // Largest chunk of output streamed to the master
+#define MT_SYNEXEC_SLAVE_OUTPUT_FLUSH   100                     // Longest time streamed output is held back (msecs)
+#define MT_SYNEXEC_SLAVE_SPIN_NSEC      2000000                 // Busy-wait this long before a scheduled start
+#define MT_SYNEXEC_SLAVE_CMDLINE_MAX    4096                    // Longest command line in a streamed configuration
+#define MT_SYNEXEC_SLAVE_INSTANCES_MAX  256                     // Most instances of a task (their reports fit in a pipe)
+#define MT_SYNEXEC_SLAVE_INSTANCE_ENV   "SYNEXEC_INSTANCE"      // Environment variable holding the instance number
+#define MT_SYNEXEC_SLAVE_INSTANCE_POLL  100                     // Look for finished instances this often while others wait on a barrier (msecs)
+#define MT_SYNEXEC_SLAVE_RT_PRIO        50                      // SCHED_FIFO priority of the armed worker (low_jitter)
+#define MT_SYNEXEC_SLAVE_RT_NSEC        10000000                // Run SCHED_FIFO and spin this long before a scheduled start (low_jitter)
+#define MT_SYNEXEC_SLAVE_BUSY_POLL      50                      // SO_BUSY_POLL on the master socket (usecs, low_jitter)
 
 // Related functions
 void *